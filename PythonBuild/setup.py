@@ -20,5 +20,5 @@ setup(
     ],
     python_requires='>=3.7',
     package_dir={'TensorFrost': 'TensorFrost'},
-    package_data={'TensorFrost': ['*.pyd']}
+    package_data={'TensorFrost': ['*.pyd', '*.so']}
 )
\ No newline at end of file
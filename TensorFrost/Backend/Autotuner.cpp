@@ -0,0 +1,247 @@
+#include "Autotuner.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <unordered_map>
+
+#include "Backends/CPU/KernelCache.h"
+#include "Backends/CPU/ThreadPool.h"
+#include "Utility/Trace.h"
+
+#ifdef __APPLE__
+#include <sys/sysctl.h>
+#endif
+
+namespace TensorFrost {
+
+bool kernel_autotuning = false;
+int kernel_autotune_runs = 3;
+
+// innermost and second innermost tile size candidates, the last ones are
+// close to running whole rows
+const vector<pair<uint, uint>> kTileCandidates = {
+    {32, 8},  {32, 32}, {64, 4},  {64, 16},  {64, 64},
+    {128, 8}, {256, 4}, {1024, 1}};
+// thread pool chunks per thread, 0 leaves the chunk size to the pool
+const vector<uint> kChunkCandidates = {0, 4, 16, 64};
+
+uint GetKernelChunkSize(uint chunks_per_thread, uint work_count,
+                        int thread_count) {
+	if (chunks_per_thread == 0) {
+		return 0;
+	}
+	return std::max(1u, work_count / (thread_count * chunks_per_thread));
+}
+
+string GetCpuModelName() {
+#ifdef _WIN32
+	const char* identifier = getenv("PROCESSOR_IDENTIFIER");
+	if (identifier != nullptr && *identifier != '\0') {
+		return identifier;
+	}
+#elif defined(__APPLE__)
+	char brand[256];
+	size_t size = sizeof(brand);
+	if (sysctlbyname("machdep.cpu.brand_string", brand, &size, nullptr, 0) ==
+	    0) {
+		return string(brand);
+	}
+#else
+	// x86 has a model name, arm only the implementer and part numbers
+	std::ifstream cpuinfo("/proc/cpuinfo");
+	string line;
+	string model;
+	while (std::getline(cpuinfo, line)) {
+		if (line.rfind("model name", 0) == 0) {
+			return line.substr(line.find(':') + 1);
+		}
+		if (line.rfind("CPU implementer", 0) == 0 ||
+		    line.rfind("CPU part", 0) == 0) {
+			model += line.substr(line.find(':') + 1);
+		}
+	}
+	if (!model.empty()) {
+		return model;
+	}
+#endif
+	return "unknown";
+}
+
+uint GetAutotuneBucket(uint64_t size) { return (uint)std::bit_width(size); }
+
+// work items of the kernel, independent of its tile size
+uint64_t GetKernelItemCount(const Kernel* kernel, const uint* shape) {
+	if (kernel->indexing_mode_ == KernelIndexingMode::Linear) {
+		return shape[0];
+	}
+	uint64_t count = 1;
+	for (int d = 0; d < kernel->dim; d++) {
+		count *= shape[d];
+	}
+	return count;
+}
+
+string GetAutotuneKey(const Kernel* kernel, const uint* shape,
+                      int thread_count) {
+	static const string cpu_model = GetCpuModelName();
+	return GetKernelCacheKey(
+	    kernel->generated_function_,
+	    "autotune threads=" + to_string(thread_count) + " size=" +
+	        to_string(GetAutotuneBucket(GetKernelItemCount(kernel, shape))),
+	    cpu_model);
+}
+
+bool ReadLaunchConfig(const string& path, size_t tile_dims,
+                      LaunchConfig& config) {
+	std::ifstream file(path);
+	string name;
+	config.tile_size.assign(tile_dims, 0);
+	file >> name;
+	if (name != "tile_size") return false;
+	for (uint& size : config.tile_size) {
+		file >> size;
+	}
+	file >> name >> config.chunks_per_thread;
+	if (!file || name != "chunks_per_thread") return false;
+	for (uint size : config.tile_size) {
+		if (size == 0) return false;
+	}
+	return true;
+}
+
+void WriteLaunchConfig(const string& key, const LaunchConfig& config) {
+	// written next to the temporary compiler files, then moved into the cache
+	std::random_device random;
+	stringstream temp_name;
+	temp_name << "tensorfrost_" << key << "_" << std::hex << random() << ".tune";
+	std::filesystem::path temp_path =
+	    std::filesystem::temp_directory_path() / temp_name.str();
+	{
+		std::ofstream file(temp_path);
+		file << "tile_size";
+		for (uint size : config.tile_size) {
+			file << " " << size;
+		}
+		file << "\nchunks_per_thread " << config.chunks_per_thread << "\n";
+		if (!file) return;
+	}
+	AddKernelFileToCache(key, ".tune", temp_path.string());
+	std::error_code error;
+	std::filesystem::remove(temp_path, error);
+}
+
+// decisions made or read by this process, so going back to an earlier size
+// doesn't time the kernels again when the kernel cache is off
+std::mutex launch_configs_mutex;
+unordered_map<string, LaunchConfig> launch_configs;
+
+bool FindLaunchConfig(const string& key, size_t tile_dims,
+                      LaunchConfig& config) {
+	{
+		std::lock_guard<std::mutex> lock(launch_configs_mutex);
+		auto found = launch_configs.find(key);
+		if (found != launch_configs.end()) {
+			config = found->second;
+			return true;
+		}
+	}
+	string path;
+	if (FindCachedKernelFile(key, ".tune", path) &&
+	    ReadLaunchConfig(path, tile_dims, config)) {
+		std::lock_guard<std::mutex> lock(launch_configs_mutex);
+		launch_configs[key] = config;
+		return true;
+	}
+	return false;
+}
+
+void ApplyLaunchConfig(const Kernel* kernel, uint* shape,
+                       const LaunchConfig& config) {
+	// tiled kernels read their tile size after the shape
+	std::copy(config.tile_size.begin(), config.tile_size.end(),
+	          shape + kernel->dim);
+}
+
+double TimeLaunchConfig(const Kernel* kernel, uint* shape,
+                        const LaunchConfig& config,
+                        const function<void(const LaunchConfig&)>& run) {
+	ApplyLaunchConfig(kernel, shape, config);
+	double best = 0.0;
+	for (int i = 0; i < std::max(1, kernel_autotune_runs); i++) {
+		auto start = std::chrono::steady_clock::now();
+		run(config);
+		double time = std::chrono::duration<double, std::milli>(
+		                  std::chrono::steady_clock::now() - start)
+		                  .count();
+		if (i == 0 || time < best) best = time;
+	}
+	return best;
+}
+
+void AutotuneKernel(const Kernel* kernel, uint* shape, bool single_threaded,
+                    LaunchConfig& config,
+                    const function<void(const LaunchConfig&)>& run) {
+	int thread_count = single_threaded ? 1 : GetThreadPool()->GetThreadCount();
+	bool tune_tiles = config.tile_size.size() >= 2;
+	bool tune_chunks = thread_count > 1;
+	if (!tune_tiles && !tune_chunks) {
+		return;
+	}
+
+	string key = GetAutotuneKey(kernel, shape, thread_count);
+	LaunchConfig best;
+	if (FindLaunchConfig(key, config.tile_size.size(), best)) {
+		ApplyLaunchConfig(kernel, shape, best);
+		config = best;
+		return;
+	}
+
+	TraceScope trace("autotune", kernel->kernel_name_);
+	best = config;
+	double best_time = TimeLaunchConfig(kernel, shape, best, run);
+
+	// tile sizes first, then the chunking of the fastest tiling
+	if (tune_tiles) {
+		int dim = kernel->dim;
+		LaunchConfig base = best;
+		for (auto& tile : kTileCandidates) {
+			LaunchConfig config = base;
+			config.tile_size[dim - 1] = tile.first;
+			config.tile_size[dim - 2] = tile.second;
+			if (config.tile_size == base.tile_size) continue;
+			double time = TimeLaunchConfig(kernel, shape, config, run);
+			if (time < best_time) {
+				best_time = time;
+				best = config;
+			}
+		}
+	}
+	if (tune_chunks) {
+		LaunchConfig base = best;
+		for (uint chunks : kChunkCandidates) {
+			if (chunks == base.chunks_per_thread) continue;
+			LaunchConfig config = base;
+			config.chunks_per_thread = chunks;
+			double time = TimeLaunchConfig(kernel, shape, config, run);
+			if (time < best_time) {
+				best_time = time;
+				best = config;
+			}
+		}
+	}
+
+	ApplyLaunchConfig(kernel, shape, best);
+	config = best;
+	WriteLaunchConfig(key, best);
+	std::lock_guard<std::mutex> lock(launch_configs_mutex);
+	launch_configs[key] = best;
+}
+
+}  // namespace TensorFrost
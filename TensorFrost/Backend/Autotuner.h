@@ -0,0 +1,47 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "IR/KernelGen.h"
+
+namespace TensorFrost {
+
+using namespace std;
+
+// time a few launch configurations of every kernel on its first run with
+// inputs of a new size and keep the fastest. The decision is stored in the
+// kernel cache, keyed by the kernel source, the CPU model, the thread count
+// and the power of two size bucket of the work, so later runs skip the timing.
+extern bool kernel_autotuning;
+// timed launches per configuration, the fastest one counts
+extern int kernel_autotune_runs;
+
+// the part of a kernel's launch that can change without recompiling it
+class LaunchConfig {
+ public:
+	vector<uint> tile_size;
+	uint chunks_per_thread = 0;
+};
+
+// thread pool chunk size of a kernel launch, 0 leaves it to the pool
+uint GetKernelChunkSize(uint chunks_per_thread, uint work_count,
+                        int thread_count);
+
+// name of the processor, part of the tuning key
+string GetCpuModelName();
+
+// power of two bucket of a size, sizes in the same bucket share their tuning
+uint GetAutotuneBucket(uint64_t size);
+
+// replaces config, the kernel's current launch configuration, with the stored
+// decision or times the candidates and stores the fastest. The kernel itself
+// is not changed. The kernel arguments must already be prepared, run launches
+// the kernel with them and the given configuration, so running it several
+// times must give the same result.
+void AutotuneKernel(const Kernel* kernel, uint* shape, bool single_threaded,
+                    LaunchConfig& config,
+                    const function<void(const LaunchConfig&)>& run);
+
+}  // namespace TensorFrost
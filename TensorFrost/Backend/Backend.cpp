@@ -1,16 +1,25 @@
 #include "Backend.h"
 
+#include <chrono>
+#include <exception>
+#include <optional>
+
 namespace TensorFrost {
 
 TensorMemoryManager* global_memory_manager = nullptr;
 
-void InitializeBackend(BackendType backendType, const string& compilerPath) {
+void InitializeBackend(BackendType backendType, const string& compilerOptions,
+                       const string& compilerPath) {
+	if (!compilerOptions.empty()) {
+		kernel_compile_options = compilerOptions;
+	}
 	if (!compilerPath.empty()) {
-		kernel_compile_options = compilerPath;
+		kernel_compiler = compilerPath;
 	}
 	switch (backendType) {
 		case BackendType::CPU:
 			global_memory_manager = new CpuMemoryManager();
+			InitializeThreadPool();
 			break;
 		case BackendType::WGPU:
 			throw std::runtime_error("WGPU backend not implemented yet");
@@ -18,146 +27,616 @@ void InitializeBackend(BackendType backendType, const string& compilerPath) {
 	}
 }
 
-vector<TensorMemory*> TensorFrost::ExecuteProgram(
-    Program* program, vector<TensorMemory*> inputs) {
-	vector<Node*> memory_inputs;
+uint GetPlanValue(const PlanValue& value, const uint* shapes,
+                  const uint* offsets) {
+	switch (value.source) {
+		case PlanValue::Source::Constant:
+			return value.value;
+		case PlanValue::Source::Shape:
+			return shapes[value.value];
+		case PlanValue::Source::Memory: {
+			uint offset = offsets[value.value];
+			return ((CpuMemoryManager*)global_memory_manager)->memory[offset];
+		}
+	}
+	return 0;
+}
+
+// copies the launch configuration of every step, the autotuner of another
+// run may publish new ones at any time
+void GetLaunchConfigs(ExecutionPlan* plan, vector<LaunchConfig>& configs) {
+	std::shared_lock<std::shared_mutex> lock(plan->autotune_mutex);
+	configs.resize(plan->steps.size());
+	for (int i = 0; i < plan->steps.size(); i++) {
+		const Kernel* kernel = plan->steps[i].kernel;
+		if (kernel != nullptr) {
+			configs[i].tile_size = kernel->tile_size;
+			configs[i].chunks_per_thread = kernel->chunks_per_thread;
+		}
+	}
+}
+
+// returns the variant for the input shapes once it is built, the first call
+// with new shapes starts building it in the background and returns nullptr
+const ShapeVariant* GetShapeVariant(ExecutionPlan* plan,
+                                    const vector<uint>& shapes,
+                                    const vector<LaunchConfig>& configs) {
+	vector<uint> key = shapes;
+	for (const LaunchConfig& config : configs) {
+		key.insert(key.end(), config.tile_size.begin(), config.tile_size.end());
+	}
+
+	std::lock_guard<std::mutex> lock(plan->shape_variants_mutex);
+	auto found = plan->shape_variants.find(key);
+	if (found != plan->shape_variants.end()) {
+		return found->second->ready ? found->second.get() : nullptr;
+	}
+	if (plan->shape_variants.size() >= kMaxShapeVariants) {
+		return nullptr;
+	}
+
+	// values that don't depend on the memory contents are known now
+	auto known = [&](const PlanValue& value) -> optional<uint> {
+		switch (value.source) {
+			case PlanValue::Source::Constant:
+				return value.value;
+			case PlanValue::Source::Shape:
+				return shapes[value.value];
+			default:
+				return std::nullopt;
+		}
+	};
+
+	// the sources are generated here, only the compiler runs in the background
+	vector<pair<string, string>> kernels;
+	vector<int> kernel_steps;
+	for (int i = 0; i < plan->steps.size(); i++) {
+		const PlanStep& step = plan->steps[i];
+		if (step.type != KernelType::Compute) {
+			continue;
+		}
+		vector<optional<uint>> variables;
+		for (const PlanValue& value : step.variables) {
+			variables.push_back(known(value));
+		}
+		vector<optional<uint>> shape;
+		optional<uint> thread_count = 1;
+		for (const PlanValue& value : step.shape) {
+			shape.push_back(known(value));
+			thread_count = thread_count && shape.back()
+			                   ? optional<uint>(*thread_count * *shape.back())
+			                   : std::nullopt;
+		}
+		if (step.linear) {
+			shape[0] = thread_count;
+		}
+		for (uint size : configs[i].tile_size) {
+			shape.push_back(size);
+		}
+		kernels.emplace_back(step.kernel->kernel_name_,
+		                     GenerateSpecializedCKernel(step.kernel, variables,
+		                                                shape));
+		kernel_steps.push_back(i);
+	}
+
+	auto variant = std::make_unique<ShapeVariant>();
+	ShapeVariant* building = variant.get();
+	int step_count = (int)plan->steps.size();
+	building->builder = std::thread([building, kernels = std::move(kernels),
+	                                 kernel_steps = std::move(kernel_steps),
+	                                 step_count]() {
+		try {
+			vector<KernelRangeCallback> callbacks =
+			    CompileKernelVariant(kernels, building->unload_callback);
+			building->kernels.resize(step_count);
+			for (int k = 0; k < kernel_steps.size(); k++) {
+				building->kernels[kernel_steps[k]] = callbacks[k];
+			}
+			building->ready = true;
+		} catch (const std::exception& e) {
+			// the generic kernels keep running these shapes
+			cerr << "Cannot build shape specialized kernels: " << e.what() << endl;
+		}
+	});
+	plan->shape_variants[key] = std::move(variant);
+	return nullptr;
+}
+
+void WaitForShapeVariants(ExecutionPlan* plan) {
+	std::lock_guard<std::mutex> lock(plan->shape_variants_mutex);
+	for (auto& variant : plan->shape_variants) {
+		if (variant.second->builder.joinable()) {
+			variant.second->builder.join();
+		}
+	}
+}
+
+// the memory a run allocates, freed when the run returns or throws. Outputs
+// are only kept once the run is done, an exception from a kernel, the
+// autotuner or an allocation frees them with the rest
+class RunAllocations {
+ public:
+	const ExecutionPlan* plan;
+	vector<TensorMemory*>& memory;
+	// temporary arena of a run that could not use the plan's one
+	TensorMemory* private_arena = nullptr;
+	bool keep_outputs = false;
+
+	RunAllocations(const ExecutionPlan* plan, vector<TensorMemory*>& memory)
+	    : plan(plan), memory(memory) {}
+	RunAllocations(const RunAllocations&) = delete;
+	RunAllocations& operator=(const RunAllocations&) = delete;
 
-	for (auto node = program->ir_->begin(); !node.is_end(); ++node) {
-		if (node->memory_type_ == MemoryType::Input) {
-			memory_inputs.push_back(*node);
+	~RunAllocations() {
+		for (const PlanStep& step : plan->steps) {
+			if (step.type == KernelType::Memory &&
+			    !(step.is_output && keep_outputs)) {
+				delete memory[step.memory_slot];
+				memory[step.memory_slot] = nullptr;
+			}
 		}
+		delete private_arena;
 	}
+};
 
-	if (memory_inputs.size() != inputs.size()) {
+vector<TensorMemory*> ExecuteProgram(ExecutionPlan* plan,
+                                     const vector<TensorMemory*>& inputs) {
+	TraceScope trace("execute", "ExecuteProgram");
+	if (plan->inputs.size() != inputs.size()) {
 		throw std::runtime_error(
 		    "Invalid number of inputs for TensorProgram. Expected " +
-		    to_string(memory_inputs.size()) + ", got " + to_string(inputs.size()));
-	}
-
-	map<Node*, TensorMemory*> memory_map;
-	map<Node*, int> shape_constants;
-	for (int i = 0; i < memory_inputs.size(); i++) {
-		memory_map[memory_inputs[i]] = inputs[i];
-		// get shape arguments
-		Arguments args = memory_inputs[i]->GetArguments(Arg::Shape);
-		vector<int> shape = inputs[i]->GetShape();
-		for (int j = 0; j < args.size(); j++) {
-			Node* shape_node = args[j].from_->get();
-			// if shape node is a constant, compare constant value to input shape
-			if (shape_node->name == "const") {
-				int val = shape_node->GetTensor()->data[0];
-				if (val != shape[j]) {
-					throw std::runtime_error("Invalid input shape " + to_string(j) +
-					                         " for input " + to_string(i) +
-					                         ". Expected " + to_string(val) + ", got " +
-					                         to_string(shape[j]));
-				}
+		    to_string(plan->inputs.size()) + ", got " + to_string(inputs.size()));
+	}
+
+	// per thread scratch space, reused between calls
+	thread_local vector<TensorMemory*> memory;
+	thread_local vector<uint> shapes;
+	thread_local vector<uint> arguments;
+	thread_local vector<uint> slot_offsets;
+	thread_local vector<uint> group_offsets;
+	// elements of each slot, for the profiler
+	thread_local vector<uint> slot_sizes;
+	thread_local vector<LaunchConfig> configs;
+	memory.assign(plan->memory_slot_count, nullptr);
+	shapes.assign(plan->shape_slot_count, 0);
+	arguments.resize(plan->argument_count);
+	slot_offsets.assign(plan->memory_slot_count, 0);
+	slot_sizes.assign(plan->memory_slot_count, 0);
+
+	for (int i = 0; i < inputs.size(); i++) {
+		const PlanInput& input = plan->inputs[i];
+		const vector<int>& shape = inputs[i]->shape;
+		memory[input.memory_slot] = inputs[i];
+		slot_offsets[input.memory_slot] = inputs[i]->frame->start;
+		slot_sizes[input.memory_slot] = inputs[i]->GetSize();
+		// if shape node is a constant, compare constant value to input shape
+		for (auto& dim : input.checked_dims) {
+			if (dim.first >= shape.size() || dim.second != shape[dim.first]) {
+				throw std::runtime_error(
+				    "Invalid input shape " + to_string(dim.first) + " for input " +
+				    to_string(i) + ". Expected " + to_string(dim.second) + ", got " +
+				    (dim.first < shape.size() ? to_string(shape[dim.first])
+				                              : string("nothing")));
+			}
+		}
+		for (auto& dim : input.shape_slots) {
+			if (dim.first < shape.size()) {
+				shapes[dim.second] = shape[dim.first];
 			}
+		}
+	}
 
-			shape_constants[shape_node] = shape[j];
+	// size the arena groups now that all static shapes are known
+	group_offsets.assign(plan->arena_group_count + 1, 0);
+	for (const PlanBuffer& buffer : plan->arena_buffers) {
+		uint size = 1;
+		for (auto& dim : buffer.shape) {
+			size *= GetPlanValue(dim, shapes.data(), slot_offsets.data());
 		}
+		slot_sizes[buffer.memory_slot] = size;
+		size = (size + kArenaAlignment - 1) / kArenaAlignment * kArenaAlignment;
+		group_offsets[buffer.group + 1] =
+		    std::max(group_offsets[buffer.group + 1], size);
+	}
+	for (int i = 0; i < plan->arena_group_count; i++) {
+		group_offsets[i + 1] += group_offsets[i];
 	}
+	uint arena_size = group_offsets[plan->arena_group_count];
+
+	RunAllocations allocations(plan, memory);
 
-	unordered_set<TensorMemory*> temp_memory;
-	map<int, TensorMemory*> output_memory;
-	// go over the kernels and execute them
-	for (auto& i : program->kernels_) {
-		Kernel* kernel = &i;
+	// the cached arena is used by one call at a time, concurrent calls get
+	// their own temporary one
+	std::unique_lock<std::mutex> arena_lock(plan->arena_mutex, std::try_to_lock);
+	TensorMemory* arena = nullptr;
+	if (arena_size > 0) {
+		if (arena_lock.owns_lock()) {
+			if (plan->arena == nullptr || plan->arena->GetSize() < arena_size) {
+				delete plan->arena;
+				plan->arena = global_memory_manager->Allocate({(int)arena_size});
+			}
+			arena = plan->arena;
+		} else {
+			arena = global_memory_manager->Allocate({(int)arena_size});
+			allocations.private_arena = arena;
+		}
+		for (const PlanBuffer& buffer : plan->arena_buffers) {
+			slot_offsets[buffer.memory_slot] =
+			    arena->frame->start + group_offsets[buffer.group];
+		}
+	}
+
+	auto allocate = [&](const PlanStep& step) {
+		if (step.in_arena) {
+			return;
+		}
+		vector<int> shape(step.shape.size());
+		for (int i = 0; i < shape.size(); i++) {
+			shape[i] = (int)GetPlanValue(step.shape[i], shapes.data(),
+			                             slot_offsets.data());
+		}
+		memory[step.memory_slot] = global_memory_manager->Allocate(shape);
+		slot_offsets[step.memory_slot] = memory[step.memory_slot]->frame->start;
+		slot_sizes[step.memory_slot] = memory[step.memory_slot]->GetSize();
+	};
+
+	// fill the variables, offsets and shape of a compute step
+	auto prepare_arguments = [&](const PlanStep& step) {
+		uint* variables = arguments.data() + step.argument_offset;
+		uint* offsets = variables + step.variables.size();
+		uint* shape = offsets + step.memory_slots.size();
+
+		uint thread_count = 1;
+		for (int i = 0; i < step.shape.size(); i++) {
+			shape[i] =
+			    GetPlanValue(step.shape[i], shapes.data(), slot_offsets.data());
+			thread_count *= shape[i];
+		}
+		if (step.linear) {
+			shape[0] = thread_count;
+		}
+		// tiled kernels get their tile size after the shape
+		const vector<uint>& tile_size = configs[&step - plan->steps.data()].tile_size;
+		std::copy(tile_size.begin(), tile_size.end(), shape + step.shape.size());
+
+		for (int i = 0; i < step.memory_slots.size(); i++) {
+			offsets[i] = slot_offsets[step.memory_slots[i]];
+		}
+		for (int i = 0; i < step.variables.size(); i++) {
+			variables[i] = GetPlanValue(step.variables[i], shapes.data(),
+			                            slot_offsets.data());
+		}
+	};
 
-		switch (kernel->type_) {
-			case KernelType::Memory: {
-				Node* node = kernel->begin_;
-				// get shape arguments
-				ArgMap args = node->GetArgumentMap(Arg::Shape);
-				uint dims = MaxIndexCount(args);
-				// get shape from shape constants
-				vector<int> shape;
-				for (int i = 0; i < dims; i++) {
-					Node* shape_node = args[i]->from_->get();
-					if (shape_node->name == "const") {
-						shape.push_back(shape_node->GetTensor()->data[0]);
-						continue;
-					}
-					shape.push_back(shape_constants[shape_node]);
+	// the first run with inputs of a new size bucket tunes the kernels for it
+	// on its own copy of the launch configurations and publishes them when it
+	// is done, concurrent runs keep the current ones meanwhile. No lock is held
+	// while kernels run, they may wait for the thread pool.
+	GetLaunchConfigs(plan, configs);
+	bool autotune = false;
+	vector<uint> autotune_bucket;
+	if (kernel_autotuning) {
+		for (uint size : shapes) {
+			autotune_bucket.push_back(GetAutotuneBucket(size));
+		}
+		auto needs_tuning = [&]() {
+			return !plan->autotuning &&
+			       (!plan->autotuned || plan->autotune_bucket != autotune_bucket);
+		};
+		bool tune = false;
+		{
+			std::shared_lock<std::shared_mutex> lock(plan->autotune_mutex);
+			tune = needs_tuning();
+		}
+		if (tune) {
+			std::unique_lock<std::shared_mutex> lock(plan->autotune_mutex);
+			autotune = needs_tuning();
+			plan->autotuning = plan->autotuning || autotune;
+		}
+	}
+
+	// kernels specialized for these shapes, tuning runs the generic ones
+	const ShapeVariant* variant = nullptr;
+	if (kernel_specialization && !plan->program->single_threaded && !autotune) {
+		variant = GetShapeVariant(plan, shapes, configs);
+	}
+	// the specialized entry point of a step if there is one, else the generic
+	auto range_callback = [&](const PlanStep& step) -> const KernelRangeCallback& {
+		return variant != nullptr ? variant->kernels[&step - plan->steps.data()]
+		                          : step.kernel->execute_range_callback;
+	};
+
+	// launches a compute step with its arguments as they are
+	auto launch = [&](const PlanStep& step, const LaunchConfig& config) {
+		uint* variables = arguments.data() + step.argument_offset;
+		uint* offsets = variables + step.variables.size();
+		uint* shape = offsets + step.memory_slots.size();
+		TraceScope trace("kernel", step.kernel->kernel_name_);
+		const KernelRangeCallback& kernel = range_callback(step);
+		uint work_count = GetKernelWorkCount(step.kernel, shape);
+		auto run_range = [&](uint begin, uint end) {
+			kernel(global_memory_manager, variables, offsets, shape, begin, end);
+		};
+		if (plan->program->single_threaded) {
+			run_range(0, work_count);
+			return;
+		}
+		ThreadPool* pool = GetThreadPool();
+		pool->ParallelFor(work_count, run_range,
+		                  GetKernelChunkSize(config.chunks_per_thread, work_count,
+		                                     pool->GetThreadCount()));
+	};
+
+	auto execute = [&](const PlanStep& step) {
+		uint* variables = arguments.data() + step.argument_offset;
+		uint* offsets = variables + step.variables.size();
+		uint* shape = offsets + step.memory_slots.size();
+		const LaunchConfig& config = configs[&step - plan->steps.data()];
+		if (!kernel_profiling) {
+			launch(step, config);
+			return;
+		}
+
+		PerfCounterValues counters;
+		auto start = std::chrono::steady_clock::now();
+		if (kernel_hardware_counters) {
+			// every thread reads its own counters around the ranges it runs
+			std::mutex counters_mutex;
+			auto run_range = [&](uint begin, uint end) {
+				PerfCounterValues range_start = ReadThreadPerfCounters();
+				range_callback(step)(global_memory_manager, variables, offsets, shape,
+				                     begin, end);
+				PerfCounterValues range = ReadThreadPerfCounters() - range_start;
+				std::lock_guard<std::mutex> lock(counters_mutex);
+				counters.Add(range);
+			};
+			uint work_count = GetKernelWorkCount(step.kernel, shape);
+			if (plan->program->single_threaded) {
+				run_range(0, work_count);
+			} else {
+				ThreadPool* pool = GetThreadPool();
+				pool->ParallelFor(work_count, run_range,
+				                  GetKernelChunkSize(config.chunks_per_thread,
+				                                     work_count,
+				                                     pool->GetThreadCount()));
+			}
+		} else {
+			launch(step, config);
+		}
+		double time = std::chrono::duration<double, std::milli>(
+		                  std::chrono::steady_clock::now() - start)
+		                  .count();
+
+		uint64_t threads = 1;
+		for (int i = 0; i < step.shape.size(); i++) {
+			threads *= shape[i];
+			if (step.linear) break;
+		}
+		uint64_t bytes = 0;
+		for (int slot : step.memory_slots) {
+			bytes += (uint64_t)slot_sizes[slot] * sizeof(uint);
+		}
+		std::lock_guard<std::mutex> lock(plan->profile.mutex);
+		plan->profile.steps[&step - plan->steps.data()].AddSample(time, threads,
+		                                                          bytes, counters);
+	};
+
+	if (!kernel_concurrency || plan->program->single_threaded ||
+	    kernel_profiling || autotune) {
+		// go over the kernels and execute them in program order
+		try {
+			for (const PlanStep& step : plan->steps) {
+				if (step.type == KernelType::Memory) {
+					allocate(step);
+					continue;
 				}
-				TensorMemory* memory = global_memory_manager->Allocate(shape);
-				if (node->memory_type_ != MemoryType::Output) {
-					temp_memory.insert(memory);
-				} else {
-					output_memory[node->memory_index_] = memory;
+				prepare_arguments(step);
+				if (autotune && step.repeatable) {
+					uint* shape = arguments.data() + step.argument_offset +
+					              step.variables.size() + step.memory_slots.size();
+					AutotuneKernel(step.kernel, shape, plan->program->single_threaded,
+					               configs[&step - plan->steps.data()],
+					               [&](const LaunchConfig& config) {
+						               launch(step, config);
+					               });
 				}
-				memory_map[node] = memory;
-			} break;
-			case KernelType::Compute: {
-				Node* begin = kernel->begin_;
-				ArgMap shape = kernel->shape;
-				int dim = kernel->dim;
-				vector<uint> shape_values(dim);
-				int thread_count = 1;
-
-				for (int i = 0; i < dim; i++) 
-				{
-					const Arg* arg = shape[i];
-					int val = 0;
-					if (arg->from_->get()->name == "const") 
-					{
-						val = arg->from_->get()->GetTensor()->data[0];
-					}
-					else
-					{
-						val = shape_constants[arg->from_->get()];
-					}
-
-					thread_count *= val;
-					shape_values[i] = val;
+				execute(step);
+			}
+		} catch (...) {
+			if (autotune) {
+				std::unique_lock<std::shared_mutex> lock(plan->autotune_mutex);
+				plan->autotuning = false;
+			}
+			throw;
+		}
+		if (autotune) {
+			std::unique_lock<std::shared_mutex> lock(plan->autotune_mutex);
+			for (int i = 0; i < plan->steps.size(); i++) {
+				Kernel* kernel = plan->steps[i].kernel;
+				if (kernel != nullptr) {
+					kernel->tile_size = configs[i].tile_size;
+					kernel->chunks_per_thread = configs[i].chunks_per_thread;
 				}
-
-				if (kernel->indexing_mode_ == KernelIndexingMode::Linear)
-				{
-					shape_values[0] = thread_count;
+			}
+			plan->autotuned = true;
+			plan->autotune_bucket = autotune_bucket;
+			plan->autotuning = false;
+		}
+	} else {
+		// levels run one after another, the kernels inside a level share one
+		// parallel loop over all of their work items
+		thread_local vector<const PlanStep*> level_kernels;
+		thread_local vector<uint> work_begin;
+		for (int level = 0; level + 1 < plan->level_begin.size(); level++) {
+			level_kernels.clear();
+			for (int i = plan->level_begin[level]; i < plan->level_begin[level + 1];
+			     i++) {
+				const PlanStep& step = plan->steps[plan->level_steps[i]];
+				if (step.type == KernelType::Memory) {
+					allocate(step);
+				} else {
+					level_kernels.push_back(&step);
 				}
+			}
+			for (const PlanStep* step : level_kernels) {
+				prepare_arguments(*step);
+			}
 
-				vector<uint> memory_offsets;
-				memory_offsets.resize(kernel->memory.size());
-				vector<uint> variables;
-				variables.resize(kernel->variables.size());
-				for (auto& j : kernel->memory) {
-					memory_offsets[j.second] = memory_map[j.first]->frame->start;
-				}
-				for (auto& j : kernel->variables) {
-					// if variable is a constant, add constant value to variable offsets
-					if (j.first->name == "const") {
-						variables[j.second] = j.first->GetTensor()->data[0];
-					} else {
-						if (shape_constants.contains(j.first)) {
-							variables[j.second] = shape_constants[j.first];
-						} else {
-							// otherwise, load variable from memory
-							uint offset = memory_map[j.first]->frame->start;
-							uint variable =
-							    ((CpuMemoryManager*)global_memory_manager)->memory[offset];
-							variables[j.second] = variable;
-						}
-					}
-				}
+			if (level_kernels.empty()) {
+				continue;
+			}
+			if (level_kernels.size() == 1) {
+				execute(*level_kernels[0]);
+				continue;
+			}
+
+			TraceScope trace_level("kernel", "level");
+			work_begin.assign(level_kernels.size() + 1, 0);
+			for (int k = 0; k < level_kernels.size(); k++) {
+				const PlanStep& step = *level_kernels[k];
+				uint* shape = arguments.data() + step.argument_offset +
+				              step.variables.size() + step.memory_slots.size();
+				work_begin[k + 1] =
+				    work_begin[k] + GetKernelWorkCount(step.kernel, shape);
+			}
 
-				kernel->execute_callback(global_memory_manager, variables,
-				                         memory_offsets, shape_values);
-			} break;
+			// the loop runs on other threads, so it must not name the
+			// thread_local buffers
+			const PlanStep* const* kernels = level_kernels.data();
+			const uint* kernel_begin = work_begin.data();
+			int kernel_count = (int)level_kernels.size();
+			uint* argument_data = arguments.data();
+			TensorMemoryManager* memory_manager = global_memory_manager;
+			const ShapeVariant* level_variant = variant;
+			const PlanStep* first_step = plan->steps.data();
+			GetThreadPool()->ParallelFor(
+			    kernel_begin[kernel_count], [&](uint begin, uint end) {
+				    for (int k = 0; k < kernel_count; k++) {
+					    uint first = std::max(begin, kernel_begin[k]);
+					    uint last = std::min(end, kernel_begin[k + 1]);
+					    if (first >= last) {
+						    continue;
+					    }
+					    const PlanStep& step = *kernels[k];
+					    uint* variables = argument_data + step.argument_offset;
+					    uint* offsets = variables + step.variables.size();
+					    uint* shape = offsets + step.memory_slots.size();
+					    const KernelRangeCallback& kernel =
+					        level_variant != nullptr
+					            ? level_variant->kernels[&step - first_step]
+					            : step.kernel->execute_range_callback;
+					    kernel(memory_manager, variables, offsets, shape,
+					           first - kernel_begin[k], last - kernel_begin[k]);
+				    }
+			    });
 		}
 	}
 
-	// delete allocated tensormemory
-	for (auto it = temp_memory.begin(); it != temp_memory.end(); ++it) {
-		delete *it;
+	vector<TensorMemory*> outputs;
+	outputs.reserve(plan->outputs.size());
+	for (int slot : plan->outputs) {
+		outputs.push_back(memory[slot]);
+	}
+	// the intermediates and the private arena are freed on return
+	allocations.keep_outputs = true;
+	return outputs;
+}
+
+// threads kept busy by the largest kernel of a run with these inputs
+int GetKernelParallelism(ExecutionPlan* plan,
+                         const vector<TensorMemory*>& inputs) {
+	if (plan->program->single_threaded || inputs.size() != plan->inputs.size()) {
+		return 1;
+	}
+	vector<uint> shapes(plan->shape_slot_count, 0);
+	for (int i = 0; i < inputs.size(); i++) {
+		for (auto& dim : plan->inputs[i].shape_slots) {
+			if (dim.first < inputs[i]->shape.size()) {
+				shapes[dim.second] = inputs[i]->shape[dim.first];
+			}
+		}
 	}
 
-	vector<TensorMemory*> outputs;
-	outputs.reserve(output_memory.size());
-	for (auto i : output_memory) {
-		outputs.push_back(i.second);
+	vector<LaunchConfig> configs;
+	GetLaunchConfigs(plan, configs);
+
+	ThreadPool* pool = GetThreadPool();
+	int parallelism = 1;
+	vector<uint> shape;
+	for (const PlanStep& step : plan->steps) {
+		if (step.type != KernelType::Compute) {
+			continue;
+		}
+		const LaunchConfig& config = configs[&step - plan->steps.data()];
+		// shapes are never data dependent, so no memory offsets are needed
+		shape.clear();
+		uint thread_count = 1;
+		for (const PlanValue& value : step.shape) {
+			shape.push_back(GetPlanValue(value, shapes.data(), nullptr));
+			thread_count *= shape.back();
+		}
+		if (step.linear) {
+			shape[0] = thread_count;
+		}
+		shape.insert(shape.end(), config.tile_size.begin(),
+		             config.tile_size.end());
+		uint work_count = GetKernelWorkCount(step.kernel, shape.data());
+		parallelism = std::max(
+		    parallelism,
+		    pool->GetLoopThreadCount(
+		        work_count, GetKernelChunkSize(config.chunks_per_thread,
+		                                       work_count,
+		                                       pool->GetThreadCount())));
+	}
+	return parallelism;
+}
+
+vector<vector<TensorMemory*>> ExecuteProgramBatch(
+    ExecutionPlan* plan, const vector<vector<TensorMemory*>>& inputs) {
+	vector<vector<TensorMemory*>> outputs(inputs.size());
+	std::exception_ptr error;
+
+	// parallelize whichever of the instances and the kernels keeps more
+	// threads busy, kernels started from inside an instance run inline
+	ThreadPool* pool = GetThreadPool();
+	int instance_parallelism =
+	    std::min((int)inputs.size(), pool->GetThreadCount());
+	int kernel_parallelism = 1;
+	for (const auto& instance_inputs : inputs) {
+		if (kernel_parallelism >= instance_parallelism) break;
+		kernel_parallelism = std::max(kernel_parallelism,
+		                              GetKernelParallelism(plan, instance_inputs));
+	}
+	try {
+		if (instance_parallelism > kernel_parallelism) {
+			// one instance per work item, the kernels of an instance then run on
+			// the thread that picked it up
+			pool->ParallelFor(
+			    (uint)inputs.size(),
+			    [&](uint begin, uint end) {
+				    for (uint i = begin; i < end; i++) {
+					    outputs[i] = ExecuteProgram(plan, inputs[i]);
+				    }
+			    },
+			    1);
+		} else {
+			for (int i = 0; i < inputs.size(); i++) {
+				outputs[i] = ExecuteProgram(plan, inputs[i]);
+			}
+		}
+	} catch (...) {
+		error = std::current_exception();
+	}
+
+	if (error) {
+		for (auto& instance_outputs : outputs) {
+			for (TensorMemory* memory : instance_outputs) {
+				delete memory;
+			}
+		}
+		std::rethrow_exception(error);
 	}
 	return outputs;
 }
 
-}  // namespace TensorFrost
\ No newline at end of file
+}  // namespace TensorFrost
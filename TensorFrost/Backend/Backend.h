@@ -8,8 +8,10 @@
 #include <utility>
 #include <vector>
 
-#include "Backends\CPU\CPU.h"
-#include "CodeGen\Generators.h"
+#include "Autotuner.h"
+#include "Backends/CPU/CPU.h"
+#include "CodeGen/Generators.h"
+#include "ExecutionQueue.h"
 #include "KernelExecutor.h"
 #include "TensorMemory.h"
 
@@ -24,10 +26,20 @@ enum class BackendType {
 	WGPU,
 };
 
-vector<TensorMemory*> ExecuteProgram(Program* program,
-                                     vector<TensorMemory*> inputs);
+vector<TensorMemory*> ExecuteProgram(ExecutionPlan* plan,
+                                     const vector<TensorMemory*>& inputs);
+
+// runs the program once per input set. Instances too small for their kernels
+// to fill the thread pool are spread over it with each instance's kernels on
+// a single thread, larger ones run one after another with parallel kernels
+vector<vector<TensorMemory*>> ExecuteProgramBatch(
+    ExecutionPlan* plan, const vector<vector<TensorMemory*>>& inputs);
+
+// blocks until the shape specialized kernels requested so far are built
+void WaitForShapeVariants(ExecutionPlan* plan);
 
 void InitializeBackend(BackendType backendType,
+                       const string& compilerOptions = "",
                        const string& compilerPath = "");
 
 }  // namespace TensorFrost
\ No newline at end of file
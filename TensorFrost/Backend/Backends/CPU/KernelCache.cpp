@@ -0,0 +1,249 @@
+#include "KernelCache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <vector>
+
+namespace TensorFrost {
+
+namespace fs = std::filesystem;
+
+bool kernel_cache_enabled = true;
+string kernel_cache_path;
+uint64_t kernel_cache_max_size = 512ull * 1024 * 1024;
+
+fs::path GetKernelCacheDirectory() {
+	if (!kernel_cache_path.empty()) {
+		return kernel_cache_path;
+	}
+	const char* env_path = getenv("TENSORFROST_CACHE_DIR");
+	if (env_path != nullptr && *env_path != '\0') {
+		return env_path;
+	}
+#ifdef _WIN32
+	const char* local_app_data = getenv("LOCALAPPDATA");
+	if (local_app_data != nullptr && *local_app_data != '\0') {
+		return fs::path(local_app_data) / "TensorFrost" / "kernel_cache";
+	}
+#else
+	const char* xdg_cache = getenv("XDG_CACHE_HOME");
+	if (xdg_cache != nullptr && *xdg_cache != '\0') {
+		return fs::path(xdg_cache) / "tensorfrost" / "kernels";
+	}
+	const char* home = getenv("HOME");
+	if (home != nullptr && *home != '\0') {
+		return fs::path(home) / ".cache" / "tensorfrost" / "kernels";
+	}
+#endif
+	return fs::temp_directory_path() / "tensorfrost_kernel_cache";
+}
+
+// SHA-256, a hit is loaded without looking at its source, so the key must
+// not collide
+class Sha256 {
+ public:
+	void Update(const string& data) {
+		for (unsigned char c : data) {
+			block_[block_size_++] = c;
+			if (block_size_ == 64) {
+				ProcessBlock();
+				block_size_ = 0;
+			}
+		}
+		length_ += data.size();
+	}
+
+	string GetHex() {
+		uint64_t bit_length = length_ * 8;
+		block_[block_size_++] = 0x80;
+		if (block_size_ > 56) {
+			std::fill(block_ + block_size_, block_ + 64, 0);
+			ProcessBlock();
+			block_size_ = 0;
+		}
+		std::fill(block_ + block_size_, block_ + 56, 0);
+		for (int i = 0; i < 8; i++) {
+			block_[63 - i] = (unsigned char)(bit_length >> (8 * i));
+		}
+		ProcessBlock();
+
+		stringstream ss;
+		ss << std::hex << std::setfill('0');
+		for (uint32_t value : state_) {
+			ss << std::setw(8) << value;
+		}
+		return ss.str();
+	}
+
+ private:
+	static constexpr uint32_t kRoundConstants[64] = {
+	    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+	    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+	    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+	    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+	    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+	    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+	uint32_t state_[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+	                      0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+	unsigned char block_[64] = {};
+	int block_size_ = 0;
+	uint64_t length_ = 0;
+
+	static uint32_t Rotate(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+	void ProcessBlock() {
+		uint32_t w[64];
+		for (int i = 0; i < 16; i++) {
+			w[i] = (uint32_t)block_[4 * i] << 24 | (uint32_t)block_[4 * i + 1] << 16 |
+			       (uint32_t)block_[4 * i + 2] << 8 | (uint32_t)block_[4 * i + 3];
+		}
+		for (int i = 16; i < 64; i++) {
+			uint32_t s0 = Rotate(w[i - 15], 7) ^ Rotate(w[i - 15], 18) ^ (w[i - 15] >> 3);
+			uint32_t s1 = Rotate(w[i - 2], 17) ^ Rotate(w[i - 2], 19) ^ (w[i - 2] >> 10);
+			w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+		}
+
+		uint32_t a = state_[0], b = state_[1], c = state_[2], d = state_[3];
+		uint32_t e = state_[4], f = state_[5], g = state_[6], h = state_[7];
+		for (int i = 0; i < 64; i++) {
+			uint32_t s1 = Rotate(e, 6) ^ Rotate(e, 11) ^ Rotate(e, 25);
+			uint32_t choose = (e & f) ^ (~e & g);
+			uint32_t t1 = h + s1 + choose + kRoundConstants[i] + w[i];
+			uint32_t s0 = Rotate(a, 2) ^ Rotate(a, 13) ^ Rotate(a, 22);
+			uint32_t majority = (a & b) ^ (a & c) ^ (b & c);
+			uint32_t t2 = s0 + majority;
+			h = g;
+			g = f;
+			f = e;
+			e = d + t1;
+			d = c;
+			c = b;
+			b = a;
+			a = t1 + t2;
+		}
+		state_[0] += a;
+		state_[1] += b;
+		state_[2] += c;
+		state_[3] += d;
+		state_[4] += e;
+		state_[5] += f;
+		state_[6] += g;
+		state_[7] += h;
+	}
+};
+
+string GetKernelCacheKey(const string& source_code, const string& options,
+                         const string& compiler_identity) {
+	Sha256 hash;
+	hash.Update(source_code);
+	hash.Update(string(1, '\0'));
+	hash.Update(options);
+	hash.Update(string(1, '\0'));
+	hash.Update(compiler_identity);
+	return hash.GetHex();
+}
+
+bool FindCachedKernelFile(const string& key, const string& extension,
+                          string& file_path) {
+	if (!kernel_cache_enabled) {
+		return false;
+	}
+	std::error_code error;
+	fs::path path = GetKernelCacheDirectory() / (key + extension);
+	if (!fs::is_regular_file(path, error)) {
+		return false;
+	}
+	// the modification time is used as the last access time for eviction
+	fs::last_write_time(path, fs::file_time_type::clock::now(), error);
+	file_path = path.string();
+	return true;
+}
+
+void EvictKernelCache(const fs::path& directory, const fs::path& keep) {
+	std::error_code error;
+	vector<pair<fs::file_time_type, fs::path>> entries;
+	uint64_t total_size = 0;
+	for (const auto& entry : fs::directory_iterator(directory, error)) {
+		// skip files that are still being inserted by some process
+		if (!entry.is_regular_file(error) ||
+		    entry.path().extension().string().rfind(".tmp", 0) == 0) {
+			continue;
+		}
+		total_size += entry.file_size(error);
+		entries.emplace_back(entry.last_write_time(error), entry.path());
+	}
+
+	if (total_size <= kernel_cache_max_size) {
+		return;
+	}
+
+	// remove least recently used entries first
+	std::sort(entries.begin(), entries.end());
+	for (auto& entry : entries) {
+		if (total_size <= kernel_cache_max_size) {
+			break;
+		}
+		if (entry.second == keep) {
+			continue;
+		}
+		uint64_t size = fs::file_size(entry.second, error);
+		if (fs::remove(entry.second, error)) {
+			total_size -= size;
+		}
+	}
+}
+
+string AddKernelFileToCache(const string& key, const string& extension,
+                            const string& file_path) {
+	if (!kernel_cache_enabled) {
+		return "";
+	}
+
+	std::error_code error;
+	fs::path directory = GetKernelCacheDirectory();
+	fs::create_directories(directory, error);
+	if (error) {
+		return "";
+	}
+
+	// copy next to the final location first, then rename, so other processes
+	// never observe a partially written file
+	std::random_device random;
+	stringstream temp_name;
+	temp_name << key << ".tmp" << std::hex << random() << random();
+	fs::path temp_path = directory / temp_name.str();
+	fs::path final_path = directory / (key + extension);
+
+	fs::copy_file(file_path, temp_path, fs::copy_options::overwrite_existing,
+	              error);
+	if (error) {
+		fs::remove(temp_path, error);
+		return "";
+	}
+	fs::rename(temp_path, final_path, error);
+	if (error) {
+		fs::remove(temp_path, error);
+		// another process may have inserted (and loaded) the same entry already
+		std::error_code exists_error;
+		if (!fs::is_regular_file(final_path, exists_error)) {
+			return "";
+		}
+	}
+
+	EvictKernelCache(directory, final_path);
+
+	return final_path.string();
+}
+
+}  // namespace TensorFrost
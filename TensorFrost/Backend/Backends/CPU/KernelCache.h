@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace TensorFrost {
+
+using namespace std;
+
+// On-disk cache of compiled kernel libraries and objects, shared between
+// processes. Entries are keyed by the SHA-256 of the generated source, the
+// compile options and the compiler identity (which includes the processor
+// model), so byte-identical code skips the compiler.
+extern bool kernel_cache_enabled;
+extern string kernel_cache_path;
+extern uint64_t kernel_cache_max_size;
+
+string GetKernelCacheKey(const string& source_code, const string& options,
+                         const string& compiler_identity);
+
+// returns true and the path of the cached file if the key is in the cache
+bool FindCachedKernelFile(const string& key, const string& extension,
+                          string& file_path);
+
+// copies a freshly compiled file into the cache (atomically), evicts least
+// recently used entries above the size limit and returns the cached path,
+// or an empty string if the file could not be cached
+string AddKernelFileToCache(const string& key, const string& extension,
+                            const string& file_path);
+
+}  // namespace TensorFrost
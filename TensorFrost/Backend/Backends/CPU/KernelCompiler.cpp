@@ -1,17 +1,37 @@
 #include "KernelCompiler.h"
 
+#include <atomic>
+#include <filesystem>
+#include <mutex>
 #include <sstream>
+#include <thread>
 
 namespace TensorFrost {
 
 std::string kernel_compile_options;
+std::string kernel_compiler;
+
+void WriteKernelSource(const string& sourceCode, const string& file_path) {
+	cout << "Source path: " << file_path << endl;
+
+	// Write the generated source code to a file
+	std::ofstream out_file(file_path);
+	if (!out_file) {
+		throw std::runtime_error(
+		    "Compiler error: cannot open file for writing generated source code");
+	}
+	out_file << sourceCode;
+	out_file.close();
+}
+
+#ifdef _WIN32
 
 bool RunCompiler(TCHAR* tempPath, TCHAR* dllName) {
 	cout << "Compile options: " << kernel_compile_options << endl;
 	std::basic_stringstream<TCHAR> ss;
-	ss << "powershell -command \"$VisualStudioPath = & \\\"${Env:ProgramFiles(x86)}\\Microsoft Visual Studio\\Installer\\vswhere.exe\\\" -latest -products * -property installationPath; & cmd.exe /C \\\"\"\\\"\\\"$VisualStudioPath\\VC\\Auxiliary\\Build\\vcvarsall.bat\\\"\\\" x64 && cl " 
+	ss << "powershell -command \"$VisualStudioPath = & \\\"${Env:ProgramFiles(x86)}\\Microsoft Visual Studio\\Installer\\vswhere.exe\\\" -latest -products * -property installationPath; & cmd.exe /C \\\"\"\\\"\\\"$VisualStudioPath\\VC\\Auxiliary\\Build\\vcvarsall.bat\\\"\\\" x64 && cl "
 	   << kernel_compile_options << " /LD " << tempPath
-	   << "generated_lib.cpp /Fe:" << dllName 
+	   << "generated_lib.cpp /Fe:" << dllName
 	   << "\"\"\\\"\"";  // MSVC
 	std::basic_string<TCHAR> command = ss.str();
 
@@ -65,26 +85,21 @@ void CompileKernelLibrary(const string& sourceCode, TCHAR* tempPath,
 	ss << tempPath << "generated_lib.cpp";  // Choose an appropriate file name
 	std::basic_string<TCHAR> full_file_path = ss.str();
 
-	const std::string& file_path(full_file_path);
-
-	cout << "Source path: " << file_path << endl;
-
-	// Write the generated source code to a file
-	std::ofstream out_file(file_path);
-	if (!out_file) {
-		throw std::runtime_error(
-		    "Compiler error: cannot open file for writing generated source code");
-	}
-	out_file << sourceCode;
-	out_file.close();
+	WriteKernelSource(sourceCode, full_file_path);
 
 	RunCompiler(tempPath, dllName);
 }
 
-using uint = unsigned int;
-using kernel_func = void (*)(uint*, uint*, uint*, uint*);
+string GetCompilerIdentity() {
+	// the code may use every instruction of this processor, see the POSIX one
+	static const string identity = "msvc\n" + GetCpuModelName();
+	return identity;
+}
 
-void CompileAndLoadKernel(Program* program) {
+const string library_extension = ".dll";
+
+string BuildKernelLibrary(const vector<pair<string, string>>& /*kernels*/,
+                          const string& source_code) {
 	TCHAR temp_path[MAX_PATH];
 	DWORD path_length = GetTempPath(MAX_PATH, temp_path);
 
@@ -100,26 +115,384 @@ void CompileAndLoadKernel(Program* program) {
 
 	cout << "Temp file: " << temp_file_name << endl;
 
-	// Generate C code
-	pair<string, vector<string>> source_names = GenerateC(program);
-	string source_code = source_names.first;
-	vector<string> kernel_names = source_names.second;
-
 	// Compile the library
 	CompileKernelLibrary(source_code, temp_path, temp_file_name);
 
+	return temp_file_name;
+}
+
+void RemoveKernelLibrary(const string& lib_path) {
+	DeleteFile(lib_path.c_str());
+}
+
+SymbolLoader LoadKernelLibrary(const string& lib_path, bool is_temporary,
+                               function<void()>& unload_callback) {
 	// Load the library
-	HMODULE lib_handle = LoadLibrary(temp_file_name);
+	HMODULE lib_handle = LoadLibrary(lib_path.c_str());
 	if (!lib_handle) {
 		throw std::runtime_error("Compiler error: cannot load generated library");
 	}
 
 	// Create lambda function to free the library
-	program->unload_callback = [lib_handle]() {
+	unload_callback = [lib_handle, lib_path, is_temporary]() {
 		if (!FreeLibrary(lib_handle)) {
 			std::cerr << "Cannot free library: " << GetLastError() << '\n';
 		}
+		if (is_temporary) {
+			RemoveKernelLibrary(lib_path);
+		}
+	};
+
+	return [lib_handle](const string& symbol_name) {
+		return reinterpret_cast<kernel_func>(
+		    GetProcAddress(lib_handle, symbol_name.c_str()));
 	};
+}
+
+#else
+
+string GetCompilerPath() {
+	if (!kernel_compiler.empty()) {
+		return kernel_compiler;
+	}
+	// fall back to the compiler the environment asks for, then to gcc
+	const char* env_compiler = getenv("CXX");
+	if (env_compiler != nullptr && *env_compiler != '\0') {
+		return env_compiler;
+	}
+	return "g++";
+}
+
+string GetCompileOptions() {
+	if (kernel_compile_options.empty()) {
+		return "-O3 -march=native";
+	}
+	return kernel_compile_options;
+}
+
+void RunCompilerCommand(const string& command) {
+	TraceScope trace("compile", "RunCompiler");
+	cout << "Command: " << command << endl;
+
+	int status = std::system(command.c_str());
+	if (status == -1) {
+		throw std::runtime_error(
+		    "Compiler error: cannot create compiler process. Command line: " +
+		    command + "\n");
+	}
+
+	// Check for compiler errors
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		throw std::runtime_error(
+		    "Compiler error: compiler exited with non-zero exit code (Error "
+		    "code: " +
+		    to_string(WEXITSTATUS(status)) + ")");
+	}
+}
+
+void RunCompilerCommands(const vector<string>& commands) {
+	// each command is a separate compiler process, run them on all cores
+	unsigned int worker_count =
+	    std::min<unsigned int>(std::max(1u, std::thread::hardware_concurrency()),
+	                           (unsigned int)commands.size());
+	std::atomic<size_t> next_command = 0;
+	vector<string> errors(commands.size());
+	vector<std::thread> workers;
+	for (unsigned int i = 0; i < worker_count; i++) {
+		workers.emplace_back([&]() {
+			size_t command;
+			while ((command = next_command++) < commands.size()) {
+				try {
+					RunCompilerCommand(commands[command]);
+				} catch (const std::exception& e) {
+					errors[command] = e.what();
+				}
+			}
+		});
+	}
+	for (auto& worker : workers) {
+		worker.join();
+	}
+
+	for (const auto& error : errors) {
+		if (!error.empty()) {
+			throw std::runtime_error(error);
+		}
+	}
+}
+
+string GetCompilerIdentity() {
+	// the version banner distinguishes compiler upgrades, so stale cache entries
+	// are never reused. The default options compile for the host processor
+	// (-march=native), so a cache shared between machines must not hand out
+	// code built on another one
+	static map<string, string> identities;
+	static std::mutex identities_mutex;
+	std::lock_guard<std::mutex> lock(identities_mutex);
+	string compiler = GetCompilerPath();
+	auto cached = identities.find(compiler);
+	if (cached != identities.end()) {
+		return cached->second;
+	}
+
+	string identity = compiler + "\n";
+	FILE* pipe = popen((compiler + " --version 2>/dev/null").c_str(), "r");
+	if (pipe != nullptr) {
+		char buffer[256];
+		while (fgets(buffer, sizeof(buffer), pipe) != nullptr) {
+			identity += buffer;
+		}
+		pclose(pipe);
+	}
+	identity += "cpu " + GetCpuModelName();
+	identities[compiler] = identity;
+	return identity;
+}
+
+const string library_extension = ".so";
+
+// gives the build its own name for a cached file, so evicting the cache entry
+// doesn't remove it before the link. False if the entry is already gone
+bool LinkCachedFile(const string& cached_path, const string& file_path) {
+	std::error_code error;
+	std::filesystem::create_hard_link(cached_path, file_path, error);
+	if (!error) {
+		return true;
+	}
+	// other file system or no hard links
+	error.clear();
+	std::filesystem::copy_file(cached_path, file_path, error);
+	return !error;
+}
+
+// removes a build directory when the build throws, the finished library
+// releases it and its loader removes the directory instead
+class TempDirectoryGuard {
+ public:
+	std::filesystem::path path;
+
+	explicit TempDirectoryGuard(const std::filesystem::path& path) : path(path) {}
+	TempDirectoryGuard(const TempDirectoryGuard&) = delete;
+	TempDirectoryGuard& operator=(const TempDirectoryGuard&) = delete;
+
+	~TempDirectoryGuard() {
+		if (!path.empty()) {
+			std::error_code error;
+			std::filesystem::remove_all(path, error);
+		}
+	}
+
+	void Release() { path.clear(); }
+};
+
+string BuildKernelLibrary(const vector<pair<string, string>>& kernels,
+                          const string& /*source_code*/) {
+	// Create a private temporary directory for the sources and the library
+	string temp_template =
+	    (std::filesystem::temp_directory_path() / "tensorfrost_XXXXXX").string();
+	if (mkdtemp(temp_template.data()) == nullptr) {
+		throw std::runtime_error("Compiler error: cannot create temp directory");
+	}
+	std::filesystem::path temp_path(temp_template);
+	TempDirectoryGuard temp_guard(temp_path);
+	string lib_path = (temp_path / "generated_lib.so").string();
+
+	cout << "Temp file: " << lib_path << endl;
+
+	string options = GetCompileOptions();
+	string compiler = GetCompilerPath();
+	string identity = GetCompilerIdentity();
+	cout << "Compile options: " << options << endl;
+
+	// every kernel is a separate translation unit sharing the prelude header,
+	// so they compile in parallel and unchanged kernels reuse cached objects
+	string prelude = GenerateCPrelude();
+	WriteKernelSource(prelude, (temp_path / "kernel_prelude.h").string());
+
+	vector<string> objects;
+	vector<string> commands;
+	vector<pair<string, string>> new_objects;
+	for (const auto& kernel : kernels) {
+		string source = "#include \"kernel_prelude.h\"\n" + kernel.second;
+		string key = GetKernelCacheKey(prelude + source, options, identity);
+
+		string object_path = (temp_path / (kernel.first + ".o")).string();
+		string cached_path;
+		if (FindCachedKernelFile(key, ".o", cached_path) &&
+		    LinkCachedFile(cached_path, object_path)) {
+			objects.push_back(object_path);
+			continue;
+		}
+
+		string source_path = (temp_path / (kernel.first + ".cpp")).string();
+		WriteKernelSource(source, source_path);
+		commands.push_back(compiler + " " + options + " -fPIC -c \"" +
+		                   source_path + "\" -o \"" + object_path + "\"");
+		objects.push_back(object_path);
+		new_objects.emplace_back(key, object_path);
+	}
+
+	RunCompilerCommands(commands);
+
+	for (auto& object : new_objects) {
+		AddKernelFileToCache(object.first, ".o", object.second);
+	}
+
+	// link the library
+	stringstream link;
+	link << compiler << " " << options << " -shared -fPIC";
+	for (const auto& object : objects) {
+		link << " \"" << object << "\"";
+	}
+	link << " -o \"" << lib_path << "\"";
+	RunCompilerCommand(link.str());
+
+	temp_guard.Release();
+	return lib_path;
+}
+
+void RemoveKernelLibrary(const string& lib_path) {
+	// the library lives in its own temp directory together with the source
+	std::error_code error;
+	std::filesystem::remove_all(std::filesystem::path(lib_path).parent_path(),
+	                            error);
+}
+
+SymbolLoader LoadKernelLibrary(const string& lib_path, bool is_temporary,
+                               function<void()>& unload_callback) {
+	// Load the library
+	void* lib_handle = dlopen(lib_path.c_str(), RTLD_NOW | RTLD_LOCAL);
+	if (!lib_handle) {
+		throw std::runtime_error(
+		    string("Compiler error: cannot load generated library: ") +
+		    dlerror());
+	}
+
+	// Create lambda function to free the library
+	unload_callback = [lib_handle, lib_path, is_temporary]() {
+		if (dlclose(lib_handle) != 0) {
+			std::cerr << "Cannot free library: " << dlerror() << '\n';
+		}
+		if (is_temporary) {
+			RemoveKernelLibrary(lib_path);
+		}
+	};
+
+	return [lib_handle](const string& symbol_name) {
+		return reinterpret_cast<kernel_func>(
+		    dlsym(lib_handle, symbol_name.c_str()));
+	};
+}
+
+#endif
+
+SymbolLoader CompileAndLoadLibrary(const vector<pair<string, string>>& kernels,
+                                   const string& source_code,
+                                   function<void()>& unload_callback) {
+	string cache_key = GetKernelCacheKey(source_code, kernel_compile_options,
+	                                     GetCompilerIdentity());
+
+	string lib_path;
+	if (FindCachedKernelFile(cache_key, library_extension, lib_path)) {
+		cout << "Loading cached kernel library: " << lib_path << endl;
+		TraceScope trace("compile", "LoadKernelLibrary");
+		return LoadKernelLibrary(lib_path, false, unload_callback);
+	}
+
+	string temp_lib_path;
+	{
+		TraceScope trace("compile", "BuildKernelLibrary");
+		temp_lib_path = BuildKernelLibrary(kernels, source_code);
+	}
+
+	lib_path = AddKernelFileToCache(cache_key, library_extension,
+	                                   temp_lib_path);
+	TraceScope trace("compile", "LoadKernelLibrary");
+	if (lib_path.empty()) {
+		// caching disabled or failed, use the temporary library directly, the
+		// unload callback owns its directory once it loaded
+		try {
+			return LoadKernelLibrary(temp_lib_path, true, unload_callback);
+		} catch (...) {
+			RemoveKernelLibrary(temp_lib_path);
+			throw;
+		}
+	}
+
+	RemoveKernelLibrary(temp_lib_path);
+	return LoadKernelLibrary(lib_path, false, unload_callback);
+}
+
+KernelRangeCallback GetKernelRangeCallback(kernel_func kernel_callback) {
+	return [kernel_callback](TensorMemoryManager* memory_manager,
+	                         uint* variables, uint* offsets, uint* shape,
+	                         uint begin, uint end) {
+		// get CPU memory manager
+		auto* cpu_memory_manager = dynamic_cast<CpuMemoryManager*>(memory_manager);
+		if (!cpu_memory_manager) {
+			throw std::runtime_error("Cannot execute kernel on non-CPU memory manager");
+		}
+		// get memory
+		uint* memory = cpu_memory_manager->memory.data();
+		// execute kernel
+		kernel_callback(variables, offsets, memory, shape, begin, end);
+	};
+}
+
+vector<KernelRangeCallback> CompileKernelVariant(
+    const vector<pair<string, string>>& kernels,
+    function<void()>& unload_callback) {
+	// one variant builds at a time, the compiler already runs on all cores
+	static std::mutex build_mutex;
+	std::lock_guard<std::mutex> lock(build_mutex);
+	TraceScope trace("compile", "CompileKernelVariant");
+	string source_code = GenerateCPrelude();
+	for (const auto& kernel : kernels) {
+		source_code += kernel.second;
+	}
+	SymbolLoader load_symbol =
+	    CompileAndLoadLibrary(kernels, source_code, unload_callback);
+
+	vector<KernelRangeCallback> callbacks;
+	for (const auto& kernel : kernels) {
+		kernel_func kernel_callback = load_symbol(kernel.first);
+		if (!kernel_callback) {
+			throw std::runtime_error("Compiler error: cannot load kernel function");
+		}
+		callbacks.push_back(GetKernelRangeCallback(kernel_callback));
+	}
+	return callbacks;
+}
+
+void CompileAndLoadKernel(Program* program) {
+	// Generate C code
+	pair<string, vector<string>> source_names;
+	{
+		TraceScope trace("compile", "GenerateC");
+		source_names = GenerateC(program);
+	}
+	string source_code = source_names.first;
+	vector<string> kernel_names = source_names.second;
+
+	// Compile and load the library
+	SymbolLoader load_symbol;
+	{
+		TraceScope trace("compile", "CompileKernelLibrary");
+		program->single_threaded =
+		    kernel_jit_enabled &&
+		    JITCompileKernelLibrary(program, source_code, load_symbol);
+		if (!program->single_threaded) {
+			vector<pair<string, string>> kernels;
+			for (auto& kernel : program->kernels_) {
+				if (kernel.type_ == KernelType::Compute) {
+					kernels.emplace_back(kernel.kernel_name_,
+					                     kernel.generated_function_);
+				}
+			}
+			load_symbol = CompileAndLoadLibrary(kernels, source_code,
+			                                    program->unload_callback);
+		}
+	}
 
 	// Load symbols for each kernel
 	int i = 0;
@@ -132,28 +505,34 @@ void CompileAndLoadKernel(Program* program) {
 		string kernel_name = kernel_names[i];
 		const string& symbol_name = kernel_name;
 
-		auto kernel_callback = reinterpret_cast<kernel_func>(
-		    GetProcAddress(lib_handle, symbol_name.c_str()));
+		kernel_func kernel_callback = load_symbol(symbol_name);
 
 		if (!kernel_callback) {
 			throw std::runtime_error("Compiler error: cannot load kernel function");
 		}
 
-		kernel->execute_callback = [kernel_callback](
+		kernel->execute_range_callback = GetKernelRangeCallback(kernel_callback);
+
+		kernel->execute_callback = [kernel, program](
 		                               TensorMemoryManager* memory_manager,
-		                               vector<uint> variables, vector<uint> offsets,
-		                               vector<uint> shape) {
-			// get CPU memory manager
-			auto* cpu_memory_manager =
-			    dynamic_cast<CpuMemoryManager*>(memory_manager);
-			if (!cpu_memory_manager) {
-				throw std::runtime_error(
-				    "Cannot execute kernel on non-CPU memory manager");
+		                               uint* variables, uint* offsets,
+		                               uint* shape) {
+			TraceScope trace("kernel", kernel->kernel_name_);
+			// execute kernel in chunks on the thread pool
+			uint work_count = GetKernelWorkCount(kernel, shape);
+			auto run_range = [&](uint begin, uint end) {
+				kernel->execute_range_callback(memory_manager, variables, offsets,
+				                               shape, begin, end);
+			};
+			if (program->single_threaded) {
+				run_range(0, work_count);
+			} else {
+				ThreadPool* pool = GetThreadPool();
+				pool->ParallelFor(
+				    work_count, run_range,
+				    GetKernelChunkSize(kernel->chunks_per_thread, work_count,
+				                       pool->GetThreadCount()));
 			}
-			// get memory
-			uint* memory = cpu_memory_manager->memory.data();
-			// execute kernel
-			kernel_callback(variables.data(), offsets.data(), memory, shape.data());
 		};
 
 		i++;
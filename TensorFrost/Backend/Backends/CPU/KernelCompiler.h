@@ -9,21 +9,40 @@
 #include <utility>
 #include <vector>
 
+#ifdef _WIN32
 #define NOMINMAX
 #include <windows.h>
+#else
+#include <dlfcn.h>
+#include <sys/wait.h>
 
+#include <cstdlib>
+#endif
+
+#include "Backend/Autotuner.h"
+#include "Backend/Backends/CPU/KernelCache.h"
+#include "Backend/Backends/CPU/KernelJIT.h"
 #include "Backend/Backends/CPU/Memory.h"
+#include "Backend/Backends/CPU/ThreadPool.h"
 #include "Backend/CodeGen/Generators.h"
 #include "Backend/KernelExecutor.h"
 #include "Backend/TensorMemory.h"
 #include "IR/KernelGen.h"
+#include "Utility/Trace.h"
 
 namespace TensorFrost {
 
 using namespace std;
 
 extern std::string kernel_compile_options;
+extern std::string kernel_compiler;
 
 void CompileAndLoadKernel(Program* program);
 
+// compiles a separate library of kernel entry points, given as name and
+// function source pairs, and returns their range callbacks in the same order
+vector<KernelRangeCallback> CompileKernelVariant(
+    const vector<pair<string, string>>& kernels,
+    function<void()>& unload_callback);
+
 }  // namespace TensorFrost
\ No newline at end of file
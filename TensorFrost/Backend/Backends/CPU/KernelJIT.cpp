@@ -0,0 +1,131 @@
+#include "KernelJIT.h"
+
+#include <iostream>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+namespace TensorFrost {
+
+bool kernel_jit_enabled = false;
+#ifdef _WIN32
+string kernel_jit_library = "libtcc.dll";
+#else
+string kernel_jit_library = "libtcc.so";
+#endif
+
+// subset of the libtcc API, see libtcc.h
+struct TCCState;
+constexpr int TCC_OUTPUT_MEMORY = 1;
+void* const TCC_RELOCATE_AUTO = reinterpret_cast<void*>(1);
+
+class TCCLibrary {
+ public:
+	TCCState* (*tcc_new)() = nullptr;
+	void (*tcc_delete)(TCCState*) = nullptr;
+	void (*tcc_set_error_func)(TCCState*, void*,
+	                           void (*)(void*, const char*)) = nullptr;
+	int (*tcc_set_output_type)(TCCState*, int) = nullptr;
+	int (*tcc_add_library)(TCCState*, const char*) = nullptr;
+	int (*tcc_compile_string)(TCCState*, const char*) = nullptr;
+	// newer versions take no second argument, passing one is harmless
+	int (*tcc_relocate)(TCCState*, void*) = nullptr;
+	void* (*tcc_get_symbol)(TCCState*, const char*) = nullptr;
+
+	bool loaded = false;
+
+	explicit TCCLibrary(const string& path) {
+#ifdef _WIN32
+		HMODULE handle = LoadLibrary(path.c_str());
+		auto load = [&](const char* name) {
+			return reinterpret_cast<void*>(GetProcAddress(handle, name));
+		};
+#else
+		void* handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+		auto load = [&](const char* name) { return dlsym(handle, name); };
+#endif
+		if (!handle) {
+			return;
+		}
+		tcc_new = reinterpret_cast<decltype(tcc_new)>(load("tcc_new"));
+		tcc_delete = reinterpret_cast<decltype(tcc_delete)>(load("tcc_delete"));
+		tcc_set_error_func = reinterpret_cast<decltype(tcc_set_error_func)>(
+		    load("tcc_set_error_func"));
+		tcc_set_output_type = reinterpret_cast<decltype(tcc_set_output_type)>(
+		    load("tcc_set_output_type"));
+		tcc_add_library =
+		    reinterpret_cast<decltype(tcc_add_library)>(load("tcc_add_library"));
+		tcc_compile_string = reinterpret_cast<decltype(tcc_compile_string)>(
+		    load("tcc_compile_string"));
+		tcc_relocate =
+		    reinterpret_cast<decltype(tcc_relocate)>(load("tcc_relocate"));
+		tcc_get_symbol =
+		    reinterpret_cast<decltype(tcc_get_symbol)>(load("tcc_get_symbol"));
+		loaded = tcc_new && tcc_delete && tcc_set_error_func &&
+		         tcc_set_output_type && tcc_add_library && tcc_compile_string &&
+		         tcc_relocate && tcc_get_symbol;
+	}
+};
+
+TCCLibrary* GetTCCLibrary() {
+	// the library stays loaded for the lifetime of the process
+	static map<string, TCCLibrary*> libraries;
+	auto found = libraries.find(kernel_jit_library);
+	if (found != libraries.end()) {
+		return found->second;
+	}
+	auto* library = new TCCLibrary(kernel_jit_library);
+	if (!library->loaded) {
+		std::cerr << "JIT unavailable: cannot load " << kernel_jit_library
+		          << ", using the external compiler" << endl;
+	}
+	libraries[kernel_jit_library] = library;
+	return library;
+}
+
+bool JITCompileKernelLibrary(Program* program, const string& source_code,
+                             SymbolLoader& load_symbol) {
+	TCCLibrary* tcc = GetTCCLibrary();
+	if (!tcc->loaded) {
+		return false;
+	}
+
+	TCCState* state = tcc->tcc_new();
+	if (state == nullptr) {
+		return false;
+	}
+
+	string errors;
+	tcc->tcc_set_error_func(state, &errors, [](void* opaque, const char* msg) {
+		*static_cast<string*>(opaque) += string(msg) + "\n";
+	});
+	tcc->tcc_set_output_type(state, TCC_OUTPUT_MEMORY);
+#ifndef _WIN32
+	tcc->tcc_add_library(state, "m");
+#endif
+
+	if (tcc->tcc_compile_string(state, source_code.c_str()) == -1 ||
+	    tcc->tcc_relocate(state, TCC_RELOCATE_AUTO) < 0) {
+		std::cerr << "JIT compilation failed, using the external compiler:\n"
+		          << errors;
+		tcc->tcc_delete(state);
+		return false;
+	}
+
+	// the compiled code is owned by the state
+	program->unload_callback = [tcc, state]() { tcc->tcc_delete(state); };
+
+	load_symbol = [tcc, state](const string& symbol_name) {
+		return reinterpret_cast<kernel_func>(
+		    tcc->tcc_get_symbol(state, symbol_name.c_str()));
+	};
+
+	cout << "Compiled kernel library in memory (JIT)." << endl;
+	return true;
+}
+
+}  // namespace TensorFrost
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <functional>
+#include <string>
+
+#include "IR/KernelGen.h"
+
+namespace TensorFrost {
+
+using namespace std;
+
+using uint = unsigned int;
+// variables, offsets, memory, shape, first and past the last work item
+using kernel_func = void (*)(uint*, uint*, uint*, uint*, uint, uint);
+using SymbolLoader = function<kernel_func(const string&)>;
+
+// In-process compilation of the generated kernels with libtcc, which is loaded
+// at runtime so there is no build dependency on it. Kernels compiled this way
+// skip the compiler process entirely, but are single threaded (TinyCC has no
+// atomics) and less optimized, which suits small and interactively built
+// programs.
+extern bool kernel_jit_enabled;
+extern string kernel_jit_library;
+
+// returns false if libtcc is not available or fails to compile the source, in
+// which case the caller should fall back to the external compiler
+bool JITCompileKernelLibrary(Program* program, const string& source_code,
+                             SymbolLoader& load_symbol);
+
+}  // namespace TensorFrost
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <algorithm>
+#include <cstring>
 #include <functional>
 #include <iostream>
 #include <map>
@@ -9,6 +10,8 @@
 #include <vector>
 
 #include "../../TensorMemory.h"
+#include "Utility/Trace.h"
+#include "VirtualMemory.h"
 
 namespace TensorFrost {
 
@@ -16,15 +19,18 @@ using namespace std;
 
 class CpuMemoryManager : public TensorMemoryManager {
  public:
-	vector<uint> memory;
+	VirtualMemory memory;
+
+	// free ranges at least this large (in elements) are returned to the OS
+	static constexpr uint32_t kReleaseThreshold = 1 << 16;
 
 	TensorMemory* Allocate(const vector<int>& shape) override {
+		TraceScope trace("memory", "Allocate");
 		int size = GetLinearSize(shape);
+		std::lock_guard<std::mutex> lock(mutex);
 		Frame* frame = allocator.AllocateFrame(size);
-		// reserve space in memory if needed
-		if (frame->end > memory.size()) {
-			memory.resize(frame->end * 3 / 2);
-		}
+		// commit more of the reserved range if needed
+		memory.Commit(frame->end);
 
 		auto* tensor_memory = new TensorMemory(shape, frame, this);
 		allocated[frame] = tensor_memory;
@@ -39,6 +45,12 @@ class CpuMemoryManager : public TensorMemoryManager {
 		return tensor_memory;
 	}
 
+	// tensors live in a reserved address range, so this stays valid for the
+	// lifetime of the tensor
+	uint* GetData(const TensorMemory* mem) {
+		return memory.data() + mem->frame->start;
+	}
+
 	vector<uint> Readback(const TensorMemory* mem) override {
 		vector<uint> data;
 		data.resize(mem->GetSize());
@@ -48,14 +60,20 @@ class CpuMemoryManager : public TensorMemoryManager {
 	}
 
 	void Free(TensorMemory* memory) override {
+		TraceScope trace("memory", "Free");
 		Frame* frame = memory->frame;
-		allocator.FreeFrame(*frame);
+		std::lock_guard<std::mutex> lock(mutex);
 		allocated.erase(frame);
+		auto [start, end] = allocator.FreeFrame(frame);
+		if (end - start >= kReleaseThreshold) {
+			this->memory.Release(start, end);
+		}
 	}
 
 	~CpuMemoryManager() override {
-		for (auto& pair : allocated) {
-			delete pair.second;
+		// deleting a TensorMemory removes it from the map
+		while (!allocated.empty()) {
+			delete allocated.begin()->second;
 		}
 	}
 };
@@ -0,0 +1,110 @@
+#include "PerfCounters.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <vector>
+#endif
+
+namespace TensorFrost {
+
+bool kernel_hardware_counters = false;
+
+#ifdef __linux__
+
+// counters of one thread, opened as one group so they are all scheduled
+// together and ratios like IPC come from the same time window
+class ThreadPerfCounters {
+ public:
+	// file descriptor of every counter, -1 if not available
+	array<int, kPerfCounterCount> fds{};
+	int leader = -1;
+	// counters in the group in the order the group read returns them
+	vector<int> members;
+
+	ThreadPerfCounters() {
+		const pair<uint32_t, uint64_t> events[kPerfCounterCount] = {
+		    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+		    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+		    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+		    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+		    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+		    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+		};
+		for (int i = 0; i < kPerfCounterCount; i++) {
+			perf_event_attr attr;
+			memset(&attr, 0, sizeof(attr));
+			attr.size = sizeof(attr);
+			attr.type = events[i].first;
+			attr.config = events[i].second;
+			// user space only, allowed with the default perf_event_paranoid
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			// the group is multiplexed as a whole if there are not enough
+			// counters, the times scale all of its values alike
+			attr.read_format = PERF_FORMAT_GROUP |
+			                   PERF_FORMAT_TOTAL_TIME_ENABLED |
+			                   PERF_FORMAT_TOTAL_TIME_RUNNING;
+			// the first counter that opens leads the group, a counter the
+			// machine doesn't have is left out
+			fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+			if (fds[i] < 0) continue;
+			if (leader < 0) leader = fds[i];
+			members.push_back(i);
+		}
+	}
+
+	ThreadPerfCounters(const ThreadPerfCounters&) = delete;
+	ThreadPerfCounters& operator=(const ThreadPerfCounters&) = delete;
+
+	~ThreadPerfCounters() {
+		// members before the leader
+		for (int i = kPerfCounterCount - 1; i >= 0; i--) {
+			if (fds[i] >= 0) close(fds[i]);
+		}
+	}
+
+	PerfCounterValues Read() const {
+		PerfCounterValues result;
+		if (leader < 0) {
+			return result;
+		}
+		// count, time enabled, time running, then a value per member
+		uint64_t data[3 + kPerfCounterCount];
+		ssize_t size = (ssize_t)((3 + members.size()) * sizeof(uint64_t));
+		if (read(leader, data, sizeof(data)) != size ||
+		    data[0] != members.size()) {
+			return result;
+		}
+		double scale = 1.0;
+		if (data[2] != 0 && data[2] < data[1]) {
+			scale = (double)data[1] / (double)data[2];
+		}
+		for (size_t k = 0; k < members.size(); k++) {
+			int i = members[k];
+			uint64_t value = data[3 + k];
+			if (scale != 1.0) {
+				value = (uint64_t)((double)value * scale);
+			}
+			result.values[i] = value;
+			result.available |= 1u << i;
+		}
+		return result;
+	}
+};
+
+PerfCounterValues ReadThreadPerfCounters() {
+	thread_local ThreadPerfCounters counters;
+	return counters.Read();
+}
+
+#else
+
+PerfCounterValues ReadThreadPerfCounters() { return PerfCounterValues(); }
+
+#endif
+
+}  // namespace TensorFrost
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <utility>
+
+namespace TensorFrost {
+
+using namespace std;
+
+// counters read around kernel launches while profiling, through
+// perf_event_open on Linux. The hardware counters are often missing in
+// virtual machines, the software ones are always there on Linux.
+enum class PerfCounter {
+	Cycles,
+	Instructions,
+	CacheMisses,   // last level cache misses
+	BranchMisses,
+	TaskClock,     // nanoseconds of CPU time
+	PageFaults,
+	Count,
+};
+
+constexpr int kPerfCounterCount = (int)PerfCounter::Count;
+
+// read the counters of every kernel launch into the profile, only used when
+// kernel_profiling is enabled
+extern bool kernel_hardware_counters;
+
+class PerfCounterValues {
+ public:
+	array<uint64_t, kPerfCounterCount> values{};
+	// bit mask of the counters that could be read
+	uint32_t available = 0;
+
+	[[nodiscard]] bool Has(PerfCounter counter) const {
+		return (available & (1u << (int)counter)) != 0;
+	}
+	[[nodiscard]] uint64_t Get(PerfCounter counter) const {
+		return values[(int)counter];
+	}
+
+	void Add(const PerfCounterValues& other) {
+		for (int i = 0; i < kPerfCounterCount; i++) {
+			values[i] += other.values[i];
+		}
+		available |= other.available;
+	}
+
+	// difference of two readings of the same thread
+	[[nodiscard]] PerfCounterValues operator-(
+	    const PerfCounterValues& start) const {
+		PerfCounterValues result;
+		result.available = available & start.available;
+		for (int i = 0; i < kPerfCounterCount; i++) {
+			result.values[i] =
+			    values[i] >= start.values[i] ? values[i] - start.values[i] : 0;
+		}
+		return result;
+	}
+};
+
+// current counter values of the calling thread, the counters are opened on
+// the first call of each thread. Empty on platforms without perf_event_open.
+PerfCounterValues ReadThreadPerfCounters();
+
+}  // namespace TensorFrost
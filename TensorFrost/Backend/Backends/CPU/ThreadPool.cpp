@@ -0,0 +1,202 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace TensorFrost {
+
+int cpu_thread_count = 0;
+uint cpu_chunk_size = 0;
+bool cpu_thread_affinity = false;
+
+ThreadPool* global_thread_pool = nullptr;
+
+// set while the thread is running a part of a parallel loop
+thread_local bool inside_parallel_loop = false;
+
+// spins before a worker goes to sleep waiting for the next loop
+constexpr int kSpinCount = 4096;
+// smallest automatic chunk, in work items
+constexpr uint kMinChunkSize = 1024;
+
+void PinThread(std::thread& thread, int core) {
+#ifdef _WIN32
+	SetThreadAffinityMask(thread.native_handle(), DWORD_PTR(1) << (core % 64));
+#else
+	cpu_set_t cpu_set;
+	CPU_ZERO(&cpu_set);
+	CPU_SET(core % CPU_SETSIZE, &cpu_set);
+	pthread_setaffinity_np(thread.native_handle(), sizeof(cpu_set), &cpu_set);
+#endif
+}
+
+ThreadPool::ThreadPool(int thread_count, bool pin_threads) {
+	if (thread_count <= 0) {
+		thread_count = (int)std::max(1u, std::thread::hardware_concurrency());
+	}
+	ranges_ = std::make_unique<WorkRange[]>(thread_count);
+	// the thread calling ParallelFor is the last participant
+	for (int i = 0; i < thread_count - 1; i++) {
+		threads_.emplace_back(&ThreadPool::WorkerLoop, this, i);
+		if (pin_threads) {
+			PinThread(threads_.back(), i + 1);
+		}
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stop_ = true;
+	}
+	wake_.notify_all();
+	for (auto& thread : threads_) {
+		thread.join();
+	}
+}
+
+void ThreadPool::WorkerLoop(int index) {
+	inside_parallel_loop = true;
+	uint64_t seen_generation = 0;
+	while (true) {
+		for (int i = 0; i < kSpinCount; i++) {
+			if (generation_.load(std::memory_order_acquire) != seen_generation ||
+			    stop_) {
+				break;
+			}
+			std::this_thread::yield();
+		}
+		if (generation_.load(std::memory_order_acquire) == seen_generation) {
+			std::unique_lock<std::mutex> lock(mutex_);
+			wake_.wait(lock, [&] {
+				return stop_ || generation_.load() != seen_generation;
+			});
+		}
+		if (stop_) {
+			return;
+		}
+		seen_generation = generation_.load(std::memory_order_acquire);
+
+		RunRanges(index);
+
+		if (active_workers_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			done_.notify_one();
+		}
+	}
+}
+
+void ThreadPool::RunRanges(int index) {
+	int participants = GetThreadCount();
+	uint chunk = chunk_size_;
+	try {
+		// own range first, then steal from the others
+		for (int k = 0; k < participants; k++) {
+			WorkRange& range = ranges_[(index + k) % participants];
+			while (true) {
+				uint64_t begin =
+				    range.next.fetch_add(chunk, std::memory_order_relaxed);
+				if (begin >= range.end) {
+					break;
+				}
+				uint64_t end = std::min<uint64_t>(begin + chunk, range.end);
+				(*function_)((uint)begin, (uint)end);
+			}
+		}
+	} catch (...) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (!error_) {
+			error_ = std::current_exception();
+		}
+		// drop the remaining work
+		for (int k = 0; k < participants; k++) {
+			ranges_[k].next = ranges_[k].end;
+		}
+	}
+}
+
+uint ThreadPool::GetChunkSize(uint count, uint chunk_size) const {
+	if (chunk_size == 0) {
+		chunk_size = cpu_chunk_size;
+	}
+	if (chunk_size == 0) {
+		chunk_size = std::max(kMinChunkSize, count / (GetThreadCount() * 8));
+	}
+	return chunk_size;
+}
+
+int ThreadPool::GetLoopThreadCount(uint count, uint chunk_size) const {
+	chunk_size = GetChunkSize(count, chunk_size);
+	uint chunks = (uint)(((uint64_t)count + chunk_size - 1) / chunk_size);
+	return (int)std::min<uint>(std::max(chunks, 1u), (uint)GetThreadCount());
+}
+
+void ThreadPool::ParallelFor(uint count, const RangeFunction& function,
+                             uint chunk_size) {
+	if (count == 0) {
+		return;
+	}
+	int participants = GetThreadCount();
+	chunk_size = GetChunkSize(count, chunk_size);
+	// not worth waking the workers
+	if (participants == 1 || inside_parallel_loop || count <= chunk_size) {
+		function(0, count);
+		return;
+	}
+
+	std::lock_guard<std::mutex> submit_lock(submit_mutex_);
+
+	for (int i = 0; i < participants; i++) {
+		ranges_[i].next = (uint64_t)count * i / participants;
+		ranges_[i].end = (uint64_t)count * (i + 1) / participants;
+	}
+	function_ = &function;
+	chunk_size_ = chunk_size;
+	error_ = nullptr;
+	active_workers_ = participants - 1;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		generation_.fetch_add(1, std::memory_order_release);
+	}
+	wake_.notify_all();
+
+	inside_parallel_loop = true;
+	RunRanges(participants - 1);
+	inside_parallel_loop = false;
+
+	// the workers finish their last chunks
+	for (int i = 0; i < kSpinCount; i++) {
+		if (active_workers_.load(std::memory_order_acquire) == 0) break;
+		std::this_thread::yield();
+	}
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		done_.wait(lock, [&] { return active_workers_.load() == 0; });
+	}
+	function_ = nullptr;
+
+	if (error_) {
+		std::rethrow_exception(error_);
+	}
+}
+
+ThreadPool* GetThreadPool() {
+	if (global_thread_pool == nullptr) {
+		InitializeThreadPool();
+	}
+	return global_thread_pool;
+}
+
+void InitializeThreadPool() {
+	delete global_thread_pool;
+	global_thread_pool = new ThreadPool(cpu_thread_count, cpu_thread_affinity);
+}
+
+}  // namespace TensorFrost
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace TensorFrost {
+
+using namespace std;
+
+using uint = unsigned int;
+
+// CPU runtime settings, applied when the backend is initialized
+extern int cpu_thread_count;     // 0 = one thread per hardware thread
+extern uint cpu_chunk_size;      // 0 = chosen from the work size
+extern bool cpu_thread_affinity; // pin each worker to its own core
+
+// Persistent pool that runs kernels as ranges of work items. Every parallel
+// loop is split into one contiguous range per thread, threads take chunks
+// from the front of their own range and steal chunks from the other ranges
+// once it is empty. Workers stay resident between kernels and spin briefly
+// before sleeping, so back to back small kernels don't pay for a wake up.
+class ThreadPool {
+ public:
+	using RangeFunction = function<void(uint begin, uint end)>;
+
+	ThreadPool(int thread_count, bool pin_threads);
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+	~ThreadPool();
+
+	// number of threads running a loop, including the calling thread
+	[[nodiscard]] int GetThreadCount() const { return (int)threads_.size() + 1; }
+
+	// runs function over [0, count) split into chunks, returns once all of
+	// them are done. Loops started from inside a loop run on the calling
+	// thread only.
+	void ParallelFor(uint count, const RangeFunction& function,
+	                 uint chunk_size = 0);
+
+	// number of threads a loop over count items keeps busy
+	[[nodiscard]] int GetLoopThreadCount(uint count, uint chunk_size = 0) const;
+
+ private:
+	struct alignas(64) WorkRange {
+		std::atomic<uint64_t> next = 0;
+		uint64_t end = 0;
+	};
+
+	vector<std::thread> threads_;
+	unique_ptr<WorkRange[]> ranges_;
+
+	// one loop runs at a time, other callers wait for it
+	std::mutex submit_mutex_;
+
+	std::mutex mutex_;
+	std::condition_variable wake_;
+	std::condition_variable done_;
+	std::atomic<uint64_t> generation_ = 0;
+	std::atomic<int> active_workers_ = 0;
+	std::atomic<bool> stop_ = false;
+
+	const RangeFunction* function_ = nullptr;
+	uint chunk_size_ = 1;
+	std::exception_ptr error_;
+
+	uint GetChunkSize(uint count, uint chunk_size) const;
+	void WorkerLoop(int index);
+	void RunRanges(int index);
+};
+
+ThreadPool* GetThreadPool();
+
+// (re)creates the pool with the current settings
+void InitializeThreadPool();
+
+}  // namespace TensorFrost
@@ -0,0 +1,96 @@
+#include "VirtualMemory.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace TensorFrost {
+
+size_t GetPageSize() {
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwPageSize;
+#else
+	return (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+VirtualMemory::VirtualMemory() {
+	// reserve as much as the system allows, up to the addressable maximum
+	for (size_t size = kMaxReserve; size >= kCommitChunk; size /= 2) {
+		size_t bytes = size * sizeof(uint);
+#ifdef _WIN32
+		void* ptr = VirtualAlloc(nullptr, bytes, MEM_RESERVE, PAGE_NOACCESS);
+		if (ptr != nullptr) {
+#else
+		void* ptr = mmap(nullptr, bytes, PROT_NONE,
+		                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if (ptr != MAP_FAILED) {
+#endif
+			data_ = (uint*)ptr;
+			reserved_ = size;
+			return;
+		}
+	}
+	throw std::runtime_error("Failed to reserve address space for CPU memory");
+}
+
+VirtualMemory::~VirtualMemory() {
+	if (data_ == nullptr) return;
+#ifdef _WIN32
+	VirtualFree(data_, 0, MEM_RELEASE);
+#else
+	munmap(data_, reserved_ * sizeof(uint));
+#endif
+}
+
+void VirtualMemory::Commit(size_t size) {
+	if (size <= committed_) return;
+	if (size > reserved_) {
+		throw std::runtime_error("Out of CPU memory: requested " +
+		                         std::to_string(size * sizeof(uint)) +
+		                         " bytes, reserved " +
+		                         std::to_string(reserved_ * sizeof(uint)));
+	}
+
+	size_t new_size = (size + kCommitChunk - 1) / kCommitChunk * kCommitChunk;
+	new_size = std::min(new_size, reserved_);
+	uint* start = data_ + committed_;
+	size_t bytes = (new_size - committed_) * sizeof(uint);
+#ifdef _WIN32
+	bool success =
+	    VirtualAlloc(start, bytes, MEM_COMMIT, PAGE_READWRITE) != nullptr;
+#else
+	bool success = mprotect(start, bytes, PROT_READ | PROT_WRITE) == 0;
+#endif
+	if (!success) {
+		throw std::runtime_error("Failed to commit CPU memory");
+	}
+	committed_ = new_size;
+}
+
+void VirtualMemory::Release(size_t start, size_t end) {
+	static const size_t page_size = GetPageSize();
+	end = std::min(end, committed_);
+	// only whole pages can be released
+	uintptr_t first = ((uintptr_t)(data_ + start) + page_size - 1) /
+	                  page_size * page_size;
+	uintptr_t last = (uintptr_t)(data_ + end) / page_size * page_size;
+	if (last <= first) return;
+#ifdef _WIN32
+	VirtualAlloc((void*)first, last - first, MEM_RESET, PAGE_READWRITE);
+#else
+	madvise((void*)first, last - first, MADV_DONTNEED);
+#endif
+}
+
+}  // namespace TensorFrost
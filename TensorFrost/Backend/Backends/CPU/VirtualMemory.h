@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace TensorFrost {
+
+using uint = unsigned int;
+
+// Contiguous array of uint backed by a reserved range of virtual address
+// space. Pages are committed as the array grows, so growing never copies and
+// pointers into it stay valid, and unused ranges can be handed back to the
+// OS without unmapping them.
+class VirtualMemory {
+ private:
+	uint* data_ = nullptr;
+	size_t reserved_ = 0;   // in elements
+	size_t committed_ = 0;  // in elements
+
+ public:
+	// offsets are 32 bit, so no more than 2^32 elements are ever addressed
+	static constexpr size_t kMaxReserve = size_t(1) << 32;
+	// commit granularity, in elements (2 MB)
+	static constexpr size_t kCommitChunk = size_t(1) << 19;
+
+	VirtualMemory();
+	VirtualMemory(const VirtualMemory&) = delete;
+	VirtualMemory& operator=(const VirtualMemory&) = delete;
+	~VirtualMemory();
+
+	uint* data() { return data_; }
+	const uint* data() const { return data_; }
+	[[nodiscard]] size_t size() const { return committed_; }
+	[[nodiscard]] size_t capacity() const { return reserved_; }
+
+	uint& operator[](size_t index) { return data_[index]; }
+	const uint& operator[](size_t index) const { return data_[index]; }
+
+	// make sure elements [0, size) are accessible
+	void Commit(size_t size);
+
+	// let the OS reclaim the physical pages fully inside [start, end), their
+	// contents become undefined but they stay accessible
+	void Release(size_t start, size_t end);
+};
+
+}  // namespace TensorFrost
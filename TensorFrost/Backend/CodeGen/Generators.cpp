@@ -40,11 +40,20 @@ string GetNodeName(const Node* node, NodeNames& names, bool compact) {
 	return names[node];
 }
 
-inline string Tensor::GetConstantString() const {
+string Tensor::GetConstantString() const {
 	if (node_->name == "const" || node_->name == "dim_id") {
 		switch (type) {
-			case DataType::Float:
-				return to_string(AsFloat(data[0])) + "f";
+			case DataType::Float: {
+				// enough digits to read back the same float, to_string keeps only 6
+				ostringstream ss;
+				ss.precision(numeric_limits<float>::max_digits10);
+				ss << AsFloat(data[0]);
+				string value = ss.str();
+				if (value.find_first_of(".en") == string::npos) {
+					value += ".0";
+				}
+				return value + "f";
+			}
 			case DataType::Int:
 				return to_string(AsInt(data[0]));
 			case DataType::Uint:
@@ -86,6 +95,8 @@ void CodeGenerator::GenerateKernelLines(const IR* ir, const Lable* cluster,
 
 		Line* line = GenerateLine(&names, op, node.get(), inputs, indices, shape,
 		                          memory, kernel->memory, kernel->variables);
+		// the generator can leave out nodes it doesn't need
+		if (line == nullptr) continue;
 		line->indent = indent;
 		lines.push_back(line);
 
@@ -93,31 +104,90 @@ void CodeGenerator::GenerateKernelLines(const IR* ir, const Lable* cluster,
 			indent++;
 		}
 	}
+
+	TokenizeLines();
 }
 
-void CodeGenerator::Compactify() {
-	// merge lines if short enough and rename variables
-	map<string, Line*> line_map;
-	map<string, vector<string>> line_inputs;
-	map<string, vector<string>> line_outputs;
-
-	for (auto& line : lines) {
-		// get inputs
-		line_inputs[line->name] = vector<string>();
-		line_outputs[line->name] = vector<string>();
-
-		for (auto& arg : line->arguments) {
-			line_inputs[line->name].push_back(arg);
+CodeGenerator::~CodeGenerator() {
+	for (Line* line : lines) {
+		delete line;
+	}
+	for (Line* line : inlined_lines_) {
+		delete line;
+	}
+}
+
+// splits code at the identifiers that are names of lines
+CodeTokens TokenizeCode(const string& code,
+                        const unordered_map<string, Line*>& line_names) {
+	CodeTokens tokens;
+	auto add_text = [&](const string& text) {
+		if (tokens.empty() || tokens.back().line != nullptr) {
+			tokens.push_back({"", nullptr});
 		}
+		tokens.back().text += text;
+	};
+	size_t i = 0;
+	while (i < code.size()) {
+		size_t begin = i;
+		char c = code[i];
+		if (isalpha(c) || c == '_') {
+			while (i < code.size() && (isalnum(code[i]) || code[i] == '_')) i++;
+			string word = code.substr(begin, i - begin);
+			auto line = line_names.find(word);
+			if (line != line_names.end()) {
+				tokens.push_back({"", line->second});
+			} else {
+				add_text(word);
+			}
+		} else if (isdigit(c)) {
+			// numbers like 1.5e-3f are never names
+			while (i < code.size() && (isalnum(code[i]) || code[i] == '_' || code[i] == '.')) i++;
+			add_text(code.substr(begin, i - begin));
+		} else {
+			i++;
+			add_text(code.substr(begin, 1));
+		}
+	}
+	return tokens;
+}
 
-		// add line to map
-		line_map[line->name] = line;
+size_t GetCodeLength(const CodeTokens& tokens) {
+	size_t length = 0;
+	for (const CodeToken& token : tokens) {
+		length += token.line ? token.line->name.size() : token.text.size();
+	}
+	return length;
+}
+
+void CodeGenerator::TokenizeLines() {
+	unordered_map<string, Line*> line_names;
+	for (Line* line : lines) {
+		line_names[line->name] = line;
+	}
+	for (Line* line : lines) {
+		line->left_tokens = TokenizeCode(line->left, line_names);
+		line->expression_tokens = TokenizeCode(line->expression, line_names);
+		line->right_tokens = TokenizeCode(line->right, line_names);
+		line->inputs.clear();
+		for (const string& argument : line->arguments) {
+			auto input = line_names.find(argument);
+			if (input != line_names.end()) {
+				line->inputs.push_back(input->second);
+			}
+		}
 	}
+}
 
-	for (auto& line : lines) {
-		// get outputs
-		for (auto& arg : line->arguments) {
-			line_outputs[arg].push_back(line->name);
+void CodeGenerator::Compactify() {
+	// merge lines if short enough, the merged code is inserted in place of
+	// the references, so this is linear in the size of the generated code
+	unordered_map<Line*, int> output_count;
+	unordered_map<Line*, vector<Line*>> line_inputs;
+	for (Line* line : lines) {
+		line_inputs[line] = line->inputs;
+		for (Line* input : line->inputs) {
+			output_count[input]++;
 		}
 	}
 
@@ -125,40 +195,49 @@ void CodeGenerator::Compactify() {
 
 	// merge lines
 	const int max_line_length = 100;
-	for (auto& line : lines) {
-		int line_size = (int)line->expression.size();
-		for (int i = 0; i < line->arguments.size(); i++) {
-			string arg = line->arguments[i];
-			Line* line2 = line_map[arg];
-			int input_size = (int)line_map[arg]->expression.size();
-			int output_count = (int)line_outputs[arg].size();
-			if ((input_size + line_size < max_line_length && output_count == 1) ||
+	for (Line* line : lines) {
+		int line_size = (int)GetCodeLength(line->expression_tokens);
+		for (int i = 0; i < line->inputs.size(); i++) {
+			Line* line2 = line->inputs[i];
+			int input_size = (int)GetCodeLength(line2->expression_tokens);
+			if ((input_size + line_size < max_line_length &&
+			     output_count[line2] == 1) ||
 			    line2->cost < 1.0f) {
-				// count the number of instances of arg in line->right
-				std::regex arg_regex("\\b" + arg +
-				                     "\\b");  // regex for whole word match
-				auto words_begin = std::sregex_iterator(
-				    line->expression.begin(), line->expression.end(), arg_regex);
-				auto words_end = std::sregex_iterator();
-
-				int instances = (int)std::distance(words_begin, words_end);
+				// count the number of references to line2
+				int instances = 0;
+				for (CodeTokens* tokens : {&line->left_tokens, &line->expression_tokens,
+				                           &line->right_tokens}) {
+					for (const CodeToken& token : *tokens) {
+						if (token.line == line2) instances++;
+					}
+				}
 
 				if (instances < 2 || line2->cost < 1.0f) {
 					// merge lines
-					string replace = line2->expression;
-
+					CodeTokens replace = line2->expression_tokens;
 					if (line2->needs_parenthesis) {
-						replace = "(" + replace + ")";
+						replace.insert(replace.begin(), {"(", nullptr});
+						replace.push_back({")", nullptr});
 					}
 
-					line->expression =
-					    std::regex_replace(line->expression, arg_regex, replace);
+					for (CodeTokens* tokens : {&line->left_tokens, &line->expression_tokens,
+					                           &line->right_tokens}) {
+						CodeTokens merged;
+						for (CodeToken& token : *tokens) {
+							if (token.line == line2) {
+								merged.insert(merged.end(), replace.begin(), replace.end());
+							} else {
+								merged.push_back(std::move(token));
+							}
+						}
+						*tokens = std::move(merged);
+					}
 
 					// add inputs
-					for (auto& input : line_inputs[arg]) {
-						if (input != arg) {
-							line->arguments.push_back(input);
-							line->cost += line_map[input]->cost;
+					for (Line* input : line_inputs[line2]) {
+						if (input != line2) {
+							line->inputs.push_back(input);
+							line->cost += input->cost;
 						}
 					}
 
@@ -169,37 +248,40 @@ void CodeGenerator::Compactify() {
 	}
 
 	// remove lines
-	for (auto& line : toRemove) {
-		lines.remove(line);
-		delete line;
-	}
+	lines.remove_if([&](Line* line) { return toRemove.contains(line); });
+	inlined_lines_.insert(inlined_lines_.end(), toRemove.begin(), toRemove.end());
 }
 
 string CodeGenerator::GetFinalCode() {
+	// name the remaining lines in order
+	unordered_map<Line*, string> names;
+	int i = 0;
+	for (Line* line : lines) {
+		names[line] = "v" + to_string(i++);
+	}
+
 	string code;
-	int indent = 0;
-	for (auto& line : lines) {
+	for (Line* line : lines) {
 		for (int i = 0; i < line->indent; i++) {
 			code += "  ";
 		}
-		code += line->left;
-		code += line->expression;
-		code += line->right;
+		for (const CodeTokens* tokens : {&line->left_tokens, &line->expression_tokens,
+		                                 &line->right_tokens}) {
+			for (const CodeToken& token : *tokens) {
+				if (token.line == nullptr) {
+					code += token.text;
+				} else {
+					auto name = names.find(token.line);
+					code += name != names.end() ? name->second : token.line->name;
+				}
+			}
+		}
 		code += "\n";
 	}
 
-	// update names
-	int i = 0;
-	for (auto& line : lines) {
-		string old_name = line->name;
-		string new_name = "v" + to_string(i);
-		i++;
-		std::regex name_regex("\\b" + old_name +
-		                      "\\b");  // regex for whole word match
-		code = std::regex_replace(code, name_regex, new_name);
-		line->name = new_name;
+	for (Line* line : lines) {
+		line->name = names[line];
 	}
-
 	return code;
 }
 
@@ -1,5 +1,6 @@
 #pragma once
-#include <regex>
+#include <limits>
+#include <optional>
 #include <sstream>
 #include <string>
 #include "IR/KernelGen.h"
@@ -15,8 +16,47 @@ string GetOperationListing(const IR&, bool compact = false);
 string GenerateHLSL(const IR&);
 string GenerateKernelHLSL(const IR&, const Lable*);
 
+string GenerateCPrelude();
 pair<string, vector<string>> GenerateC(Program* program);
 
+// generate C kernels whose innermost dimension the compiler can vectorize
+extern bool kernel_vectorization;
+
+// run kernels that read neighbouring items (stencils, gathers) in tiles
+extern bool kernel_tiling;
+// leave the index clamps out of the interior of rows where no index can be
+// out of range, only the items at the borders keep them
+extern bool kernel_interior_split;
+
+// tile size of MultiDimensionalBlocks kernels, innermost dimension first,
+// the dimensions past the end of the list are not tiled
+extern vector<uint> kernel_tile_size;
+
+vector<uint> GetDefaultTileSize(int dim);
+
+// entry point of a C kernel for one set of shapes, the known variables and
+// shape values (including the tile size) are compiled in as constants and the
+// others are still read from the arguments
+string GenerateSpecializedCKernel(const Kernel* kernel,
+                                  const vector<optional<uint>>& variables,
+                                  const vector<optional<uint>>& shape);
+
+// number of work items a generated C kernel runs for the given shape, tiled
+// kernels read their tile size from shape[dim .. 2 * dim)
+uint GetKernelWorkCount(const Kernel* kernel, const uint* shape);
+
+
+class Line;
+
+// a piece of a generated line, either plain code or a reference to the value
+// of another line, which is later inlined or printed with its final name
+class CodeToken {
+ public:
+	string text;
+	Line* line = nullptr;
+};
+
+using CodeTokens = vector<CodeToken>;
 
 class Line {
  public:
@@ -29,6 +69,13 @@ class Line {
 	bool needs_parenthesis = false;
 	float cost = 0;
 
+	// left, expression and right split at the names of other lines, and the
+	// lines named in arguments
+	CodeTokens left_tokens;
+	CodeTokens expression_tokens;
+	CodeTokens right_tokens;
+	vector<Line*> inputs;
+
 	Line(string left, string expression, string right, string name,
 	     vector<string> args, bool needs_parenthesis = false, float cost = 0, int indent = 0)
 	    : left(left), right(right), name(name), arguments(args), indent(indent), expression(expression), needs_parenthesis(needs_parenthesis), cost(cost) {}
@@ -39,6 +86,9 @@ class CodeGenerator {
 	list<Line*> lines;
 
 	CodeGenerator() = default;
+	CodeGenerator(const CodeGenerator&) = delete;
+	CodeGenerator& operator=(const CodeGenerator&) = delete;
+	virtual ~CodeGenerator();
 
 	virtual Line* GenerateLine(NodeNames* names, const Operation* op, Node* node,
 	                          Arguments inputs, Arguments indices,
@@ -50,6 +100,12 @@ class CodeGenerator {
 	                         const Kernel* kernel);
 	void Compactify();
 	string GetFinalCode();
+
+ private:
+	// lines inlined by Compactify, kept alive since they could still be named
+	list<Line*> inlined_lines_;
+
+	void TokenizeLines();
 };
 
 string AddIndent(const string& input, const string& indent);
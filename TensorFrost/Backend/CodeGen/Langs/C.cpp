@@ -5,12 +5,34 @@
 namespace TensorFrost {
 using namespace std;
 
+// how a kernel accesses one of its buffers
+class KernelBuffer {
+ public:
+	// element type of every access, None if the buffer is accessed as raw
+	// uint bits (bools, or loads and stores of different types)
+	DataType type = DataType::None;
+	bool read_only = true;
+};
+
 class C_CodeGenerator : public CodeGenerator {
  public:
+	// indexed like Kernel::memory
+	vector<KernelBuffer> buffers;
+	// index clamps known to be no-ops, generated as just their index
+	unordered_set<Node*> unclamped;
+	// loads and stores that go through a row pointer instead of computing
+	// their address, and the nodes only used for those addresses
+	unordered_map<Node*, string> row_accesses;
+	unordered_set<Node*> skipped;
+
 	Line* GenerateLine(NodeNames* names, const Operation* op, Node* node,
 	                   Arguments inputs, Arguments indices, Arguments shape,
 	                   Arguments memory, map<Node*, int> offsets,
 	                   map<Node*, int> variables) override {
+		if (skipped.contains(node)) {
+			return nullptr;
+		}
+
 		// get node names
 		vector<string> arguments;
 		vector<string> input_variables;
@@ -71,39 +93,47 @@ class C_CodeGenerator : public CodeGenerator {
 			left += "}";
 		} else if (op->op_type_ == OpType::Store || op->op_type_ == OpType::Load ||
 		           op->op_type_ == OpType::Scatter) {
-			string address = "off[" + to_string(offsets[memory[0].from_->get()]) +
-			                 "] + " + arguments[1];
-			string memory_expression = "mem[" + address + "]";
+			// buffers are addressed through their own base pointer with an int
+			// index, which the compiler can turn into vector gathers
+			int buffer_index = offsets[memory[0].from_->get()];
+			bool typed = buffers[buffer_index].type != DataType::None;
+			string buffer = "buf" + to_string(buffer_index);
+			string address = arguments[1];
+			string memory_expression = buffer + "[" + address + "]";
+			if (row_accesses.contains(node)) {
+				memory_expression = row_accesses[node];
+				std::erase(input_variables, address);
+			}
 			if (op->name_ == "load") {
+				// loads have the type of the loaded tensor
+				output_type = node->GetTensor()->type;
 				left += type_names[output_type] + " " + name + " = ";
-				if (output_type == DataType::Float) {
-					expression += "asfloat(";
-				}
-				if (output_type == DataType::Int) {
-					expression += "asint(";
-				}
-				expression += memory_expression;
-				if (output_type != DataType::Uint) {
-					expression += ")";
+				if (typed || output_type == DataType::Uint) {
+					expression += memory_expression;
+				} else if (output_type == DataType::Float) {
+					expression += "asfloat(" + memory_expression + ")";
+				} else {
+					expression += "(" + type_names[output_type] + ")" +
+					              memory_expression;
 				}
 				right += ";";
 				needs_parenthesis = false;
 			} else if (op->name_ == "store") {
 				expression += memory_expression + " = ";
-				if (input_types[0] != DataType::Uint) {
-					expression += "asuint(";
-				}
-				expression += arguments[2];
-				if (input_types[0] != DataType::Uint) {
-					expression += ")";
+				if (typed || input_types[0] == DataType::Uint) {
+					expression += arguments[2];
+				} else if (input_types[0] == DataType::Float) {
+					expression += "asuint(" + arguments[2] + ")";
+				} else {
+					expression += "(uint)" + arguments[2];
 				}
 				right += ";";
 			}
 			else if (op->op_type_ == OpType::Scatter)
 			{
 				string input_type_name = type_names[input_types[0]];
-				expression += op->code_ + "((" + input_type_name + "*)mem, " +
-				              address + ", " + arguments[2] + ")";
+				expression += op->code_ + "((" + input_type_name + "*)" + buffer +
+				              ", " + address + ", " + arguments[2] + ")";
 				right += ";";
 			}
 		} else {
@@ -120,6 +150,10 @@ class C_CodeGenerator : public CodeGenerator {
 					line += op->code_ + arguments[0];
 					break;
 				case OpType::Function:
+					if (unclamped.contains(node)) {
+						line += arguments[0];
+						break;
+					}
 					line += op->code_ + "(";
 					for (int i = 0; i < arguments.size(); i++) {
 						if (i != 0) {
@@ -164,41 +198,143 @@ class C_CodeGenerator : public CodeGenerator {
 	}
 };
 
-pair<string, vector<string>> GenerateC(Program* program) {
-	string all_kernels = R"(
+string GenerateCPrelude() {
+	return R"prelude(
+#ifdef __cplusplus
 #include <cmath>
-#include <omp.h>
+#define KERNEL_EXTERN extern "C"
+#else
+#include <math.h>
+#include <stdbool.h>
+#define KERNEL_EXTERN
+#endif
+
+#ifdef _WIN32
+#define KERNEL_EXPORT KERNEL_EXTERN __declspec(dllexport)
+#else
+#define KERNEL_EXPORT KERNEL_EXTERN __attribute__((visibility("default")))
+#endif
 
 typedef unsigned int uint;
 
-inline int min(int a, int b)
+static inline float asfloat(uint x)
 {
-  return a < b ? a : b;
+  return *(float*)&x;
 }
 
-inline int max(int a, int b)
+static inline uint asuint(float x)
 {
-  return a > b ? a : b;
+  return *(uint*)&x;
 }
 
-inline float min(float a, float b)
+// kernels run on several threads at once, scatter operations are atomic
+#if defined(__TINYC__)
+// no atomics, kernels built with TinyCC are run on a single thread
+#define TF_ATOMIC_LOAD(p) (*(p))
+#define TF_ATOMIC_ADD(p, v) (*(p) += (v))
+#define TF_ATOMIC_AND(p, v) (*(p) &= (v))
+#define TF_ATOMIC_OR(p, v) (*(p) |= (v))
+#define TF_ATOMIC_XOR(p, v) (*(p) ^= (v))
+#define TF_ATOMIC_CAS(p, expected, desired) (*(p) = (desired), 1)
+#elif defined(_MSC_VER)
+#include <intrin.h>
+#define TF_ATOMIC_LOAD(p) (*(volatile uint*)(p))
+#define TF_ATOMIC_ADD(p, v) _InterlockedExchangeAdd((volatile long*)(p), (long)(v))
+#define TF_ATOMIC_AND(p, v) _InterlockedAnd((volatile long*)(p), (long)(v))
+#define TF_ATOMIC_OR(p, v) _InterlockedOr((volatile long*)(p), (long)(v))
+#define TF_ATOMIC_XOR(p, v) _InterlockedXor((volatile long*)(p), (long)(v))
+#define TF_ATOMIC_CAS(p, expected, desired) \
+  (_InterlockedCompareExchange((volatile long*)(p), (long)(desired), (long)(expected)) == (long)(expected))
+#else
+#define TF_ATOMIC_LOAD(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+#define TF_ATOMIC_ADD(p, v) __atomic_fetch_add((p), (v), __ATOMIC_RELAXED)
+#define TF_ATOMIC_AND(p, v) __atomic_fetch_and((p), (v), __ATOMIC_RELAXED)
+#define TF_ATOMIC_OR(p, v) __atomic_fetch_or((p), (v), __ATOMIC_RELAXED)
+#define TF_ATOMIC_XOR(p, v) __atomic_fetch_xor((p), (v), __ATOMIC_RELAXED)
+#define TF_ATOMIC_CAS(p, expected, desired) \
+  __atomic_compare_exchange_n((p), &(expected), (desired), 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)
+#endif
+
+#define TF_DEFINE_ATOMIC(name, type, atomic_op) \
+  static inline void name##_##type(type* memory, int address, type value) \
+  { \
+    atomic_op(&memory[address], value); \
+  }
+
+TF_DEFINE_ATOMIC(InterlockedAdd, int, TF_ATOMIC_ADD)
+TF_DEFINE_ATOMIC(InterlockedAdd, uint, TF_ATOMIC_ADD)
+TF_DEFINE_ATOMIC(InterlockedAnd, int, TF_ATOMIC_AND)
+TF_DEFINE_ATOMIC(InterlockedAnd, uint, TF_ATOMIC_AND)
+TF_DEFINE_ATOMIC(InterlockedOr, int, TF_ATOMIC_OR)
+TF_DEFINE_ATOMIC(InterlockedOr, uint, TF_ATOMIC_OR)
+TF_DEFINE_ATOMIC(InterlockedXor, int, TF_ATOMIC_XOR)
+TF_DEFINE_ATOMIC(InterlockedXor, uint, TF_ATOMIC_XOR)
+
+static inline void InterlockedAdd_float(float* memory, int address, float value)
+{
+  uint* pointer = (uint*)&memory[address];
+  uint expected = TF_ATOMIC_LOAD(pointer);
+  uint desired = asuint(asfloat(expected) + value);
+  while (!TF_ATOMIC_CAS(pointer, expected, desired))
+  {
+    expected = TF_ATOMIC_LOAD(pointer);
+    desired = asuint(asfloat(expected) + value);
+  }
+}
+
+// the body of a kernel is shared by its generic and shape specialized entry
+// points and has to be inlined into them to see their constants
+#if defined(_MSC_VER)
+#define TF_FORCE_INLINE __forceinline
+#elif defined(__GNUC__) && !defined(__TINYC__)
+#define TF_FORCE_INLINE inline __attribute__((always_inline))
+#else
+#define TF_FORCE_INLINE inline
+#endif
+
+// buffers of a kernel never overlap
+#if defined(_MSC_VER) || defined(__GNUC__) || defined(__clang__) || defined(__TINYC__)
+#define TF_RESTRICT __restrict
+#else
+#define TF_RESTRICT
+#endif
+
+// the items of a row are independent, a buffer that is both loaded and
+// stored may still look like a loop carried dependence to the compiler
+#if defined(__clang__)
+#define TF_SIMD_LOOP _Pragma("clang loop vectorize(assume_safety)")
+#elif defined(__GNUC__) && !defined(__TINYC__)
+#define TF_SIMD_LOOP _Pragma("GCC ivdep")
+#elif defined(_MSC_VER)
+#define TF_SIMD_LOOP __pragma(loop(ivdep))
+#else
+#define TF_SIMD_LOOP
+#endif
+
+#ifdef __cplusplus
+
+// <cmath> only declares the float overloads in std, a bare abs would
+// otherwise resolve to the int version and truncate
+using std::abs;
+
+inline int min(int a, int b)
 {
   return a < b ? a : b;
 }
 
-inline float max(float a, float b)
+inline int max(int a, int b)
 {
   return a > b ? a : b;
 }
 
-inline float asfloat(uint x)
+inline float min(float a, float b)
 {
-  return *(float*)&x;
+  return a < b ? a : b;
 }
 
-inline uint asuint(float x)
+inline float max(float a, float b)
 {
-  return *(uint*)&x;
+  return a > b ? a : b;
 }
 
 inline int clamp(int x, int a, int b)
@@ -211,61 +347,474 @@ inline float clamp(float x, float a, float b)
   return min(max(x, a), b);
 }
 
-inline void InterlockedAdd(int* memory, int address, int value)
-{
-  #pragma omp atomic
-  memory[address] += value;
+inline void InterlockedAdd(int* memory, int address, int value) { InterlockedAdd_int(memory, address, value); }
+inline void InterlockedAdd(uint* memory, int address, uint value) { InterlockedAdd_uint(memory, address, value); }
+inline void InterlockedAdd(float* memory, int address, float value) { InterlockedAdd_float(memory, address, value); }
+inline void InterlockedAnd(int* memory, int address, int value) { InterlockedAnd_int(memory, address, value); }
+inline void InterlockedAnd(uint* memory, int address, uint value) { InterlockedAnd_uint(memory, address, value); }
+inline void InterlockedOr(int* memory, int address, int value) { InterlockedOr_int(memory, address, value); }
+inline void InterlockedOr(uint* memory, int address, uint value) { InterlockedOr_uint(memory, address, value); }
+inline void InterlockedXor(int* memory, int address, int value) { InterlockedXor_int(memory, address, value); }
+inline void InterlockedXor(uint* memory, int address, uint value) { InterlockedXor_uint(memory, address, value); }
+
+#else
+
+// C has no overloading, dispatch on the argument type instead
+#define TF_DEFINE_MINMAX(type) \
+  static inline type min_##type(type a, type b) { return a < b ? a : b; } \
+  static inline type max_##type(type a, type b) { return a > b ? a : b; } \
+  static inline type clamp_##type(type x, type a, type b) { return min_##type(max_##type(x, a), b); }
+
+TF_DEFINE_MINMAX(int)
+TF_DEFINE_MINMAX(uint)
+TF_DEFINE_MINMAX(float)
+
+static inline int abs_int(int x) { return x < 0 ? -x : x; }
+static inline uint abs_uint(uint x) { return x; }
+static inline float abs_float(float x) { return fabsf(x); }
+
+#define TF_SELECT(x, name) _Generic((x), float: name##_float, uint: name##_uint, default: name##_int)
+#define min(a, b) TF_SELECT(a, min)(a, b)
+#define max(a, b) TF_SELECT(a, max)(a, b)
+#define clamp(x, a, b) TF_SELECT(x, clamp)(x, a, b)
+#define abs(x) TF_SELECT(x, abs)(x)
+
+#define TF_SELECT_PTR(x, name) _Generic((x), float*: name##_float, uint*: name##_uint, default: name##_int)
+#define InterlockedAdd(memory, address, value) TF_SELECT_PTR(memory, InterlockedAdd)(memory, address, value)
+#define InterlockedAnd(memory, address, value) _Generic((memory), uint*: InterlockedAnd_uint, default: InterlockedAnd_int)(memory, address, value)
+#define InterlockedOr(memory, address, value) _Generic((memory), uint*: InterlockedOr_uint, default: InterlockedOr_int)(memory, address, value)
+#define InterlockedXor(memory, address, value) _Generic((memory), uint*: InterlockedXor_uint, default: InterlockedXor_int)(memory, address, value)
+
+#endif
+
+)prelude";
 }
 
-inline void InterlockedAdd(uint* memory, int address, uint value)
-{
-  #pragma omp atomic
-  memory[address] += value;
+bool kernel_vectorization = true;
+bool kernel_tiling = true;
+bool kernel_interior_split = true;
+// longest kernel code that still gets a second copy for the row interior,
+// larger kernels cost more to compile twice than the clamps cost to run
+const size_t kInteriorSplitMaxCodeSize = 2048;
+vector<uint> kernel_tile_size = {64, 16};
+
+vector<uint> GetDefaultTileSize(int dim) {
+	vector<uint> tile_size(dim, 1);
+	for (int k = 0; k < dim && k < (int)kernel_tile_size.size(); k++) {
+		tile_size[dim - 1 - k] = std::max(1u, kernel_tile_size[k]);
+	}
+	return tile_size;
 }
 
-inline void InterlockedAdd(float* memory, int address, float value)
-{
-  #pragma omp atomic
-  memory[address] += value;
+// steps dim0..dim{dims - 1} to the next item like an odometer, so the indices
+// don't have to be divided out for every item
+string GenerateIndexStep(int dims, int indent) {
+	string code;
+	for (int d = dims - 1; d > 0; d--) {
+		string pad(indent + 2 * (dims - 1 - d), ' ');
+		code += pad + "if (++dim" + to_string(d) + " == shape[" + to_string(d) + "])\n";
+		code += pad + "{\n";
+		code += pad + "  dim" + to_string(d) + " = 0;\n";
+	}
+	code += string(indent + 2 * (dims - 1), ' ') + "dim0++;\n";
+	for (int d = 1; d < dims; d++) {
+		code += string(indent + 2 * (dims - 1 - d), ' ') + "}\n";
+	}
+	return code;
 }
 
-inline void InterlockedAnd(int* memory, int address, int value)
-{
-  #pragma omp atomic
-  memory[address] &= value;
+// code of the items of a row and the code that runs once before the row
+class RowCode {
+ public:
+	string prologue;
+	string code;
+};
+
+// an int value along a row of the innermost dimension as offset + scale * dim,
+// where the offset and the scale are the same for the whole row
+class RowAffine {
+ public:
+	string offset;
+	string scale;
+};
+
+string NegateTerm(const string& a) {
+	if (a == "0") return a;
+	return a[0] == '-' ? a.substr(1) : "-" + a;
 }
 
-inline void InterlockedAnd(uint* memory, int address, uint value)
-{
-  #pragma omp atomic
-  memory[address] &= value;
+string AddTerms(const string& a, const string& b) {
+	if (a == "0") return b;
+	if (b == "0") return a;
+	if (b[0] == '-') return "(" + a + " - " + b.substr(1) + ")";
+	return "(" + a + " + " + b + ")";
 }
 
-inline void InterlockedOr(int* memory, int address, int value)
-{
-  #pragma omp atomic
-  memory[address] |= value;
+string MultiplyTerms(const string& a, const string& b) {
+	if (a == "0" || b == "0") return "0";
+	if (a == "1") return b;
+	if (b == "1") return a;
+	return "(" + a + " * " + b + ")";
 }
 
-inline void InterlockedOr(uint* memory, int address, uint value)
-{
-  #pragma omp atomic
-  memory[address] |= value;
+optional<RowAffine> GetRowAffine(const Kernel* kernel,
+                                 const C_CodeGenerator& generator, Node* node) {
+	if (node->GetTensor()->type != DataType::Int) {
+		return nullopt;
+	}
+	if (node->name == "const") {
+		return RowAffine{node->GetTensor()->GetConstantString(), "0"};
+	}
+	if (node->name == "memory") {
+		auto variable = kernel->variables.find(node);
+		if (variable == kernel->variables.end()) return nullopt;
+		return RowAffine{"var[" + to_string(variable->second) + "]", "0"};
+	}
+	if (node->name == "dim_id") {
+		int dim = (int)node->GetTensor()->data[0];
+		if (dim == kernel->dim - 1) return RowAffine{"0", "1"};
+		return RowAffine{"dim" + to_string(dim), "0"};
+	}
+
+	vector<RowAffine> args;
+	for (const Arg& arg : node->GetArguments(Arg::Type::Input)) {
+		optional<RowAffine> affine = GetRowAffine(kernel, generator, arg.from_->get());
+		if (!affine) return nullopt;
+		args.push_back(*affine);
+	}
+	if (args.empty()) {
+		return nullopt;
+	}
+	if (node->name == "clamp" && generator.unclamped.contains(node)) {
+		return args[0];
+	}
+	if (node->name == "add") {
+		return RowAffine{AddTerms(args[0].offset, args[1].offset),
+		                 AddTerms(args[0].scale, args[1].scale)};
+	}
+	if (node->name == "sub") {
+		return RowAffine{AddTerms(args[0].offset, NegateTerm(args[1].offset)),
+		                 AddTerms(args[0].scale, NegateTerm(args[1].scale))};
+	}
+	if (node->name == "mul") {
+		// one factor has to be the same for the whole row
+		if (args[0].scale != "0") std::swap(args[0], args[1]);
+		if (args[0].scale != "0") return nullopt;
+		return RowAffine{MultiplyTerms(args[0].offset, args[1].offset),
+		                 MultiplyTerms(args[0].offset, args[1].scale)};
+	}
+
+	// other operations of values that are the same for the whole row
+	for (const RowAffine& arg : args) {
+		if (arg.scale != "0") return nullopt;
+	}
+	const Operation* op = node->op;
+	switch (op->op_type_) {
+		case OpType::Operator:
+			return RowAffine{"(" + args[0].offset + " " + op->code_ + " " + args[1].offset + ")", "0"};
+		case OpType::UnaryOperator:
+			return RowAffine{op->code_ + "(" + args[0].offset + ")", "0"};
+		case OpType::Function: {
+			if (op->name_ != "min" && op->name_ != "max" && op->name_ != "abs" &&
+			    op->name_ != "clamp") {
+				return nullopt;
+			}
+			string call = op->code_ + "(";
+			for (int i = 0; i < (int)args.size(); i++) {
+				call += (i == 0 ? "" : ", ") + args[i].offset;
+			}
+			return RowAffine{call + ")", "0"};
+		}
+		default:
+			return nullopt;
+	}
 }
 
-inline void InterlockedXor(int* memory, int address, int value)
-{
-  #pragma omp atomic
-  memory[address] ^= value;
+// element pointer type of a buffer in the kernel body
+string GetBufferPointerType(const KernelBuffer& buffer) {
+	string type =
+	    buffer.type == DataType::None ? "uint" : DataTypeToString(buffer.type);
+	return buffer.read_only ? "const " + type : type;
 }
 
-inline void InterlockedXor(uint* memory, int address, uint value)
-{
-  #pragma omp atomic
-  memory[address] ^= value;
+// loads and stores whose address is offset + scale * dim along the row go
+// through a pointer to the row start, computed once before the row loop, the
+// address computations that aren't used otherwise are left out. Returns the
+// code that computes the pointers. The names start with prefix, since the
+// interior and the border code compute their pointers in the same scope
+string HoistRowAddresses(C_CodeGenerator& generator, const IR* ir,
+                         const Kernel* kernel, const string& prefix) {
+	Lable* cluster = kernel->begin_->cluster_head_;
+	vector<Node*> nodes;
+	for (auto node = IR::Iterator(cluster->node_); !node.is_cluster_end(cluster);
+	     ++node) {
+		nodes.push_back(node.get());
+	}
+
+	string dim = "dim" + to_string(kernel->dim - 1);
+	string prologue;
+	map<string, string> pointers;
+	map<string, string> strides;
+	for (Node* node : nodes) {
+		OpType op_type = node->op->op_type_;
+		if (op_type != OpType::Load && op_type != OpType::Store) continue;
+		Arguments index = node->GetArguments(Arg::Type::Index);
+		if (index.size() != 1) continue;
+		optional<RowAffine> address =
+		    GetRowAffine(kernel, generator, index[0].from_->get());
+		if (!address) continue;
+
+		int buffer_index =
+		    kernel->memory.at(node->GetArguments(Arg::Type::Memory)[0].from_->get());
+		string type = GetBufferPointerType(generator.buffers[buffer_index]);
+		string base = "buf" + to_string(buffer_index);
+		if (address->offset != "0") {
+			base += address->offset[0] == '-' ? " - " + address->offset.substr(1)
+			                                 : " + " + address->offset;
+		}
+		auto pointer = pointers.find(base);
+		if (pointer == pointers.end()) {
+			string name = prefix + "row" + to_string(pointers.size());
+			prologue += type + "* " + name + " = " + base + ";\n";
+			pointer = pointers.emplace(base, name).first;
+		}
+
+		// contiguous rows are indexed directly, others with their stride
+		string element = dim;
+		if (address->scale == "0") {
+			element = "0";
+		} else if (address->scale != "1") {
+			auto stride = strides.find(address->scale);
+			if (stride == strides.end()) {
+				string name = prefix + "stride" + to_string(strides.size());
+				prologue += "const int " + name + " = " + address->scale + ";\n";
+				stride = strides.emplace(address->scale, name).first;
+			}
+			element = dim + " * " + stride->second;
+		}
+		generator.row_accesses[node] = pointer->second + "[" + element + "]";
+	}
+
+	// the nodes whose only users are the replaced addresses
+	unordered_map<Node*, vector<pair<Node*, Arg::Type>>> users;
+	for (auto node = ir->begin(); !node.is_end(); ++node) {
+		for (const Arg& input : node->inputs_) {
+			users[input.from_->get()].emplace_back(node.get(), input.type_);
+		}
+	}
+	for (auto node = nodes.rbegin(); node != nodes.rend(); ++node) {
+		OpType op_type = (*node)->op->op_type_;
+		bool index_math =
+		    op_type == OpType::Operator || op_type == OpType::UnaryOperator ||
+		    op_type == OpType::DimensionIndex || (*node)->name == "min" ||
+		    (*node)->name == "max" || (*node)->name == "abs" ||
+		    (*node)->name == "clamp";
+		if (!index_math || !users.contains(*node)) continue;
+		bool address_only = true;
+		for (auto& [user, arg_type] : users[*node]) {
+			if (!(arg_type == Arg::Type::Index &&
+			      generator.row_accesses.contains(user)) &&
+			    !generator.skipped.contains(user)) {
+				address_only = false;
+			}
+		}
+		if (address_only) {
+			generator.skipped.insert(*node);
+		}
+	}
+	return prologue;
+}
+
+string GetClampSize(const Kernel* kernel, const IndexClamp& clamp) {
+	if (clamp.size->name == "const") {
+		return clamp.size->GetTensor()->GetConstantString();
+	}
+	return "var[" + to_string(kernel->variables.at(clamp.size)) + "]";
+}
+
+string AddOffset(const string& value, int offset) {
+	if (offset == 0) return value;
+	return value + (offset > 0 ? " + " : " - ") + to_string(std::abs(offset));
+}
+
+// runs the items of the innermost dimension from row_begin to row_end. With
+// index clamps the row is split into the interior, where every clamped index
+// is in range and the interior code without the clamps runs, and the items
+// before and after it, which keep the clamps
+string GenerateRowLoop(const Kernel* kernel, const vector<IndexClamp>& clamps,
+                       const string& row_begin, const string& row_end,
+                       const RowCode& code, const RowCode& interior,
+                       bool vectorize, int indent) {
+	string pad(indent, ' ');
+	string simd = vectorize ? pad + "TF_SIMD_LOOP\n" : "";
+	string dim = "dim" + to_string(kernel->dim - 1);
+	if (clamps.empty()) {
+		return AddIndent(code.prologue, pad) + simd +
+		       pad + "for (int " + dim + " = " + row_begin + "; " + dim + " < " + row_end + "; " + dim + "++)\n" +
+		       pad + "{\n" + AddIndent(code.code, pad + "  ") +
+		       pad + "}\n";
+	}
+
+	// 0 <= dim + offset < size, only the lowest and the highest offset of
+	// every index and size matter
+	map<int, int> lowest;
+	map<pair<int, string>, int> highest;
+	for (const IndexClamp& clamp : clamps) {
+		auto low = lowest.try_emplace(clamp.dim, clamp.offset).first;
+		low->second = std::min(low->second, clamp.offset);
+		auto high = highest.try_emplace({clamp.dim, GetClampSize(kernel, clamp)},
+		                                clamp.offset).first;
+		high->second = std::max(high->second, clamp.offset);
+	}
+
+	// the innermost index bounds the interior, the other indices are the same
+	// for the whole row
+	int interior_begin = 0;
+	vector<string> interior_ends;
+	vector<string> row_conditions;
+	for (auto& [clamp_dim, offset] : lowest) {
+		if (offset >= 0) continue;
+		if (clamp_dim == kernel->dim - 1) {
+			interior_begin = -offset;
+		} else {
+			row_conditions.push_back("dim" + to_string(clamp_dim) + " >= " + to_string(-offset));
+		}
+	}
+	for (auto& [key, offset] : highest) {
+		if (key.first == kernel->dim - 1) {
+			interior_ends.push_back(AddOffset(key.second, -offset));
+		} else {
+			row_conditions.push_back(AddOffset("dim" + to_string(key.first), offset) + " < " + key.second);
+		}
+	}
+
+	string loop;
+	if (interior_begin > 0) {
+		string begin = to_string(interior_begin);
+		loop += pad + "int inner_begin = " + row_begin + " > " + begin + " ? " + row_begin + " : " + begin + ";\n";
+		loop += pad + "if (inner_begin > " + row_end + ") inner_begin = " + row_end + ";\n";
+	} else {
+		loop += pad + "int inner_begin = " + row_begin + ";\n";
+	}
+	loop += pad + "int inner_end = " + row_end + ";\n";
+	for (const string& end : interior_ends) {
+		loop += pad + "if (inner_end > " + end + ") inner_end = " + end + ";\n";
+	}
+	loop += pad + "if (inner_end < inner_begin) inner_end = inner_begin;\n";
+	if (!row_conditions.empty()) {
+		string condition;
+		for (const string& row_condition : row_conditions) {
+			condition += (condition.empty() ? "" : " && ") + row_condition;
+		}
+		loop += pad + "if (!(" + condition + ")) inner_begin = inner_end = " + row_end + ";\n";
+	}
+	loop += AddIndent(interior.prologue, pad) + simd;
+	loop += pad + "for (int " + dim + " = inner_begin; " + dim + " < inner_end; " + dim + "++)\n";
+	loop += pad + "{\n" + AddIndent(interior.code, pad + "  ") + pad + "}\n";
+	loop += pad + "int border_begin[2] = {" + row_begin + ", inner_end};\n";
+	loop += pad + "int border_end[2] = {inner_begin, " + row_end + "};\n";
+	loop += AddIndent(code.prologue, pad);
+	loop += pad + "for (int border = 0; border < 2; border++)\n";
+	loop += pad + "{\n";
+	loop += vectorize ? pad + "  TF_SIMD_LOOP\n" : "";
+	loop += pad + "  for (int " + dim + " = border_begin[border]; " + dim + " < border_end[border]; " + dim + "++)\n";
+	loop += pad + "  {\n" + AddIndent(code.code, pad + "    ") + pad + "  }\n";
+	loop += pad + "}\n";
+	return loop;
+}
+
+bool CanVectorizeKernel(const Kernel* kernel) {
+	if (!kernel_vectorization ||
+	    (kernel->indexing_mode_ != KernelIndexingMode::MultiDimensional &&
+	     kernel->indexing_mode_ != KernelIndexingMode::MultiDimensionalBlocks)) {
+		return false;
+	}
+	// atomics of different items may hit the same address
+	Lable* cluster = kernel->begin_->cluster_head_;
+	for (auto node = IR::Iterator(cluster->node_); !node.is_cluster_end(cluster);
+	     ++node) {
+		if (node->op->op_type_ == OpType::Scatter) {
+			return false;
+		}
+	}
+	return true;
+}
+
+vector<KernelBuffer> GetKernelBuffers(const Kernel* kernel) {
+	vector<KernelBuffer> buffers(kernel->memory.size());
+	for (auto& memory : kernel->memory) {
+		DataType type = memory.first->GetTensor()->type;
+		if (type == DataType::Float || type == DataType::Int ||
+		    type == DataType::Uint) {
+			buffers[memory.second].type = type;
+		}
+	}
+	Lable* cluster = kernel->begin_->cluster_head_;
+	for (auto node = IR::Iterator(cluster->node_); !node.is_cluster_end(cluster);
+	     ++node) {
+		OpType op_type = node->op->op_type_;
+		if (op_type != OpType::Load && op_type != OpType::Store &&
+		    op_type != OpType::Scatter) {
+			continue;
+		}
+		Node* memory = node->GetArguments(Arg::Type::Memory)[0].from_->get();
+		KernelBuffer& buffer = buffers[kernel->memory.at(memory)];
+		DataType access_type = node->GetTensor()->type;
+		if (op_type != OpType::Load) {
+			buffer.read_only = false;
+			access_type =
+			    node->GetArguments(Arg::Type::Input)[0].from_->get()->GetTensor()->type;
+		}
+		if (access_type != buffer.type) {
+			buffer.type = DataType::None;
+		}
+	}
+	return buffers;
+}
+
+// the exported function with the common signature, it unpacks the buffers
+// from the memory and calls the body
+string GenerateCKernelEntry(const Kernel* kernel, const string& prologue,
+                            const string& var, const string& shape) {
+	return "\n"
+	       "KERNEL_EXPORT void " + kernel->kernel_name_ +
+	       "(uint* var_data, uint* off, uint* mem, uint* shape_data, uint begin, uint end)\n"
+	       "{\n" + prologue +
+	       "  " + kernel->kernel_name_ + "_body(" + var + ", " + shape +
+	       ", begin, end" + kernel->generated_buffer_arguments_ + ");\n"
+	       "}\n";
+}
+
+string GenerateSpecializedCKernel(const Kernel* kernel,
+                                  const vector<optional<uint>>& variables,
+                                  const vector<optional<uint>>& shape) {
+	// known values become constants of local arrays, once the body is inlined
+	// the compiler folds them into the index math and the loop bounds
+	string prologue;
+	string var = "(const int*)var_data";
+	if (!variables.empty()) {
+		prologue += "  const int var[" + to_string(variables.size()) + "] = {";
+		for (int k = 0; k < (int)variables.size(); k++) {
+			prologue += k == 0 ? "" : ", ";
+			prologue += variables[k] ? to_string((int)*variables[k])
+			                         : "(int)var_data[" + to_string(k) + "]";
+		}
+		prologue += "};\n";
+		var = "var";
+	}
+	prologue += "  const uint shape[" + to_string(shape.size()) + "] = {";
+	for (int d = 0; d < (int)shape.size(); d++) {
+		prologue += d == 0 ? "" : ", ";
+		prologue += shape[d] ? to_string(*shape[d]) + "u"
+		                     : "shape_data[" + to_string(d) + "]";
+	}
+	prologue += "};\n";
+	return kernel->generated_body_ +
+	       GenerateCKernelEntry(kernel, prologue, var, "shape");
 }
 
-)";
+pair<string, vector<string>> GenerateC(Program* program) {
+	string all_kernels = GenerateCPrelude();
 
 	// Generate HLSL code for each compute kernel
 	int kernel_count = 0;
@@ -280,60 +829,209 @@ inline void InterlockedXor(uint* memory, int address, uint value)
 		string kernel_name = "kernel_" + to_string(kernel_count++);
 		kernel_names.push_back(kernel_name);
 
+		// kernels that run whole rows of the innermost dimension compute the
+		// row invariant part of their addresses once per row, and get a second
+		// version of the code without the index clamps for the row interior
+		bool row_loop =
+		    kernel->indexing_mode_ == KernelIndexingMode::MultiDimensionalBlocks ||
+		    (kernel->indexing_mode_ == KernelIndexingMode::MultiDimensional &&
+		     CanVectorizeKernel(kernel));
+
 		// Generate kernel
 		C_CodeGenerator generator;
+		generator.buffers = GetKernelBuffers(kernel);
+		RowCode row_code;
+		if (row_loop) {
+			row_code.prologue = HoistRowAddresses(generator, program->ir_, kernel, "");
+		}
 		generator.GenerateKernelLines(program->ir_, cluster, kernel);
 		generator.Compactify();
+		string kernel_code = generator.GetFinalCode();
+		row_code.code = kernel_code;
+
+		if (kernel->indexing_mode_ == KernelIndexingMode::MultiDimensionalBlocks &&
+		    kernel->tile_size.empty()) {
+			kernel->tile_size = GetDefaultTileSize(kernel->dim);
+		}
+
+		// the kernel body gets every buffer as its own restrict pointer of the
+		// element type, const if it is only loaded, the exported function
+		// keeps the common signature and unpacks the buffers from the memory
+		string parameters = "const int* var, const uint* shape, uint begin, uint end";
+		string buffer_arguments = "";
+		for (int b = 0; b < (int)generator.buffers.size(); b++) {
+			const KernelBuffer& buffer = generator.buffers[b];
+			string type = GetBufferPointerType(buffer);
+			parameters += ", " + type + "* TF_RESTRICT buf" + to_string(b);
+			buffer_arguments += ", (" + type + "*)(mem + off[" + to_string(b) + "])";
+		}
 
+		vector<IndexClamp> clamps;
+		RowCode interior_code;
+		if (row_loop && kernel_interior_split &&
+		    kernel_code.size() <= kInteriorSplitMaxCodeSize) {
+			clamps = FindIndexClamps(kernel);
+			// without a clamp along the row every item of it is interior or
+			// border alike, so the copy would only remove the outer clamps
+			bool row_clamp = std::any_of(
+			    clamps.begin(), clamps.end(),
+			    [&](const IndexClamp& clamp) { return clamp.dim == kernel->dim - 1; });
+			if (!row_clamp) {
+				clamps.clear();
+			}
+		}
+		if (!clamps.empty()) {
+			C_CodeGenerator interior_generator;
+			interior_generator.buffers = generator.buffers;
+			for (const IndexClamp& clamp : clamps) {
+				interior_generator.unclamped.insert(clamp.node);
+			}
+			interior_code.prologue =
+			    HoistRowAddresses(interior_generator, program->ir_, kernel, "inner_");
+			interior_generator.GenerateKernelLines(program->ir_, cluster, kernel);
+			interior_generator.Compactify();
+			interior_code.code = interior_generator.GetFinalCode();
+		}
+
+		// the kernel runs the work items [begin, end), the host splits the full
+		// range into chunks and runs them on the thread pool
 		string loop = "";
-		const int block_size = 8; //TODO chose automatically
+		string loop_end = "";
+		string indent = "    ";
+		int last = i.dim - 1;
 		switch (kernel->indexing_mode_)
 		{
 			case KernelIndexingMode::Linear:
-				loop =  "  for (int thread_id = 0; thread_id < shape[0]; thread_id++)\n";
+				loop =  "  for (int thread_id = (int)begin; thread_id < (int)end; thread_id++)\n";
 				loop += "  {\n";
 				break;
 			case KernelIndexingMode::MultiDimensional:
-				for (int d = 0; d < i.dim; d++)
+				if (CanVectorizeKernel(kernel)) {
+					// run the range a row of the innermost dimension at a time, the
+					// row loop has no control flow besides the kernel's own and is
+					// vectorized by the compiler, with a scalar or masked remainder
+					loop = "  uint item = begin;\n";
+					loop += "  int row_begin = item % shape[" + to_string(last) + "];\n";
+					loop += "  item /= shape[" + to_string(last) + "];\n";
+					for (int d = last - 1; d > 0; d--)
+					{
+						loop += "  int dim" + to_string(d) + " = item % shape[" + to_string(d) + "];\n";
+						loop += "  item /= shape[" + to_string(d) + "];\n";
+					}
+					if (last > 0) {
+						loop += "  int dim0 = item;\n";
+					}
+					loop += "  for (uint item_id = begin; item_id < end;)\n";
+					loop += "  {\n";
+					loop += "    int row_end = (int)shape[" + to_string(last) + "];\n";
+					loop += "    if (end - item_id < (uint)(row_end - row_begin))\n";
+					loop += "    {\n";
+					loop += "      row_end = row_begin + (int)(end - item_id);\n";
+					loop += "    }\n";
+					loop += GenerateRowLoop(kernel, clamps, "row_begin", "row_end",
+					                        row_code, interior_code, true, 4);
+					loop_end = "    item_id += row_end - row_begin;\n";
+					loop_end += "    row_begin = 0;\n";
+					if (last > 0) {
+						loop_end += GenerateIndexStep(last, 4);
+					}
+					break;
+				}
+				// split the first item into indices once, then step them like an
+				// odometer instead of dividing for every item
+				loop = "  uint item = begin;\n";
+				for (int d = i.dim - 1; d > 0; d--)
 				{
-					loop += "  for (int dim" + to_string(d) + " = 0; dim" + to_string(d) + " < shape[" + to_string(d) + "]; dim" + to_string(d) + "++)\n";
+					loop += "  int dim" + to_string(d) + " = item % shape[" + to_string(d) + "];\n";
+					loop += "  item /= shape[" + to_string(d) + "];\n";
 				}
+				loop += "  int dim0 = item;\n";
+				loop += "  for (uint item_id = begin; item_id < end; item_id++)\n";
 				loop += "  {\n";
+				loop_end = GenerateIndexStep(i.dim, 4);
 				break;
-			case KernelIndexingMode::MultiDimensionalBlocks:
-				for (int d = 0; d < i.dim; d++)
+			case KernelIndexingMode::MultiDimensionalBlocks: {
+				// work items are whole tiles, the tile size of dimension d is passed
+				// in shape[dim + d] and the tiles at the far edges are cut short
+				loop = "  for (uint tile_id = begin; tile_id < end; tile_id++)\n";
+				loop += "  {\n";
+				loop += "    uint tile = tile_id;\n";
+				for (int d = i.dim - 1; d >= 0; d--)
 				{
-					loop += "  for (int wg" + to_string(d) + " = 0; wg" + to_string(d) + " < shape[" + to_string(d) + "] / " + to_string(block_size) + "; wg" + to_string(d) + "++)\n";
+					string ds = to_string(d);
+					string size = "shape[" + ds + "]";
+					string tile_size = "shape[" + to_string(i.dim + d) + "]";
+					loop += "    uint tiles" + ds + " = (" + size + " + " + tile_size + " - 1) / " + tile_size + ";\n";
+					loop += "    int begin" + ds + " = (int)(tile % tiles" + ds + " * " + tile_size + ");\n";
+					loop += "    int end" + ds + " = begin" + ds + " + (int)" + tile_size + ";\n";
+					loop += "    if (end" + ds + " > (int)" + size + ") end" + ds + " = (int)" + size + ";\n";
+					if (d > 0) {
+						loop += "    tile /= tiles" + ds + ";\n";
+					}
 				}
-				for (int d = 0; d < i.dim; d++)
+				for (int d = 0; d < last; d++)
 				{
-					loop += "  for (int lt" + to_string(d) + " = 0; lt" + to_string(d) + " < " + to_string(block_size) + "; lt" + to_string(d) + "++)\n";
+					string ds = to_string(d);
+					string pad(4 + 2 * d, ' ');
+					loop += pad + "for (int dim" + ds + " = begin" + ds + "; dim" + ds + " < end" + ds + "; dim" + ds + "++)\n";
+					loop += pad + "{\n";
 				}
-				loop += "  {\n";
-				for (int d = 0; d < i.dim; d++)
+				string ls = to_string(last);
+				loop += GenerateRowLoop(kernel, clamps, "begin" + ls, "end" + ls,
+				                        row_code, interior_code,
+				                        CanVectorizeKernel(kernel), 4 + 2 * last);
+				for (int d = last - 1; d >= 0; d--)
 				{
-					loop += "    int dim" + to_string(d) + " = wg" + to_string(d) + " * " + to_string(block_size) + " + lt" + to_string(d) + ";\n";
+					loop_end += string(4 + 2 * d, ' ') + "}\n";
 				}
-				break;
+			} break;
 			default:
 				throw std::runtime_error("Invalid indexing mode");
 				break;
 		}
 
-		string kernel_code = generator.GetFinalCode();
+		// the row loops already contain the kernel code
+		if (!row_loop) {
+			loop += AddIndent(kernel_code, indent);
+		}
 		kernel->generated_code_ = kernel_code;
-		all_kernels +=
+		kernel->kernel_name_ = kernel_name;
+		kernel->generated_body_ =
 		    "\n"
-		    "extern \"C\" __declspec(dllexport) void " + kernel_name +
-		    "(uint* var, uint* off, uint* mem, uint* shape)\n"
-		    "{\n"
-			"  #pragma omp parallel for shared(mem) \n" + loop +
-			AddIndent(kernel_code, "    ") +
+		    "static TF_FORCE_INLINE void " + kernel_name + "_body(" + parameters + ")\n"
+		    "{\n" + loop + loop_end +
 		    "  }\n"
 		    "}\n";
+		kernel->generated_buffer_arguments_ = buffer_arguments;
+		kernel->generated_function_ =
+		    kernel->generated_body_ +
+		    GenerateCKernelEntry(kernel, "", "(const int*)var_data", "shape_data");
+		all_kernels += kernel->generated_function_;
 	}
 
 	program->generated_code_ = all_kernels;
 	return pair<string, vector<string>>(all_kernels, kernel_names);
 }
-}  // namespace TensorFrost
\ No newline at end of file
+uint GetKernelWorkCount(const Kernel* kernel, const uint* shape) {
+	uint count = 1;
+	switch (kernel->indexing_mode_) {
+		case KernelIndexingMode::Linear:
+			return shape[0];
+		case KernelIndexingMode::MultiDimensional:
+			for (int d = 0; d < kernel->dim; d++) {
+				count *= shape[d];
+			}
+			return count;
+		case KernelIndexingMode::MultiDimensionalBlocks:
+			for (int d = 0; d < kernel->dim; d++) {
+				uint tile_size = shape[kernel->dim + d];
+				count *= (shape[d] + tile_size - 1) / tile_size;
+			}
+			return count;
+		default:
+			// GenerateC doesn't emit LinearBlocks kernels either
+			throw std::runtime_error("Invalid indexing mode");
+	}
+}
+
+}  // namespace TensorFrost
@@ -0,0 +1,53 @@
+#include "ExecutionQueue.h"
+
+namespace TensorFrost {
+
+ExecutionQueue::ExecutionQueue() {
+	worker_ = std::thread(&ExecutionQueue::WorkerLoop, this);
+}
+
+void ExecutionQueue::WorkerLoop() {
+	while (true) {
+		std::packaged_task<vector<TensorMemory*>()> task;
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			condition_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
+			if (tasks_.empty()) {
+				return;
+			}
+			task = std::move(tasks_.front());
+			tasks_.pop_front();
+		}
+		// exceptions are stored in the future
+		task();
+	}
+}
+
+std::shared_future<vector<TensorMemory*>> ExecutionQueue::Submit(
+    function<vector<TensorMemory*>()> task) {
+	std::packaged_task<vector<TensorMemory*>()> packaged(std::move(task));
+	std::shared_future<vector<TensorMemory*>> future = packaged.get_future();
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		tasks_.push_back(std::move(packaged));
+	}
+	condition_.notify_one();
+	return future;
+}
+
+ExecutionQueue::~ExecutionQueue() {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stop_ = true;
+	}
+	condition_.notify_one();
+	// finishes the queued work first
+	worker_.join();
+}
+
+ExecutionQueue& GetExecutionQueue() {
+	static ExecutionQueue queue;
+	return queue;
+}
+
+}  // namespace TensorFrost
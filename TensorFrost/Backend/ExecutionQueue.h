@@ -0,0 +1,43 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "TensorMemory.h"
+
+namespace TensorFrost {
+
+using namespace std;
+
+// Single background worker that runs submitted programs in order, so the
+// caller can prepare inputs or process results while kernels execute.
+// The kernels themselves are still parallel.
+class ExecutionQueue {
+	std::thread worker_;
+	std::mutex mutex_;
+	std::condition_variable condition_;
+	std::deque<std::packaged_task<vector<TensorMemory*>()>> tasks_;
+	bool stop_ = false;
+
+	void WorkerLoop();
+
+ public:
+	ExecutionQueue();
+	ExecutionQueue(const ExecutionQueue&) = delete;
+	ExecutionQueue& operator=(const ExecutionQueue&) = delete;
+
+	std::shared_future<vector<TensorMemory*>> Submit(
+	    function<vector<TensorMemory*>()> task);
+
+	~ExecutionQueue();
+};
+
+// created on first use
+ExecutionQueue& GetExecutionQueue();
+
+}  // namespace TensorFrost
@@ -0,0 +1,112 @@
+#include "FrameAllocator.h"
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+namespace TensorFrost {
+
+void FrameAllocator::AddFreeBlock(uint32_t start, uint32_t size) {
+	free_by_start_[start] = size;
+	free_by_size_.insert({size, start});
+}
+
+void FrameAllocator::RemoveFreeBlock(uint32_t start, uint32_t size) {
+	free_by_start_.erase(start);
+	free_by_size_.erase({size, start});
+}
+
+Frame* FrameAllocator::AllocateFrame(uint32_t size) {
+	uint32_t aligned_size = GetAlignedSize(size);
+	if (aligned_size < size) {
+		throw std::runtime_error("Cannot allocate a frame of " + to_string(size) +
+		                         " elements, its aligned size overflows");
+	}
+
+	uint32_t start;
+	// smallest free block that fits, lowest address among equal sizes
+	auto it = free_by_size_.lower_bound({aligned_size, 0});
+	if (it != free_by_size_.end()) {
+		uint32_t block_size = it->first;
+		start = it->second;
+		RemoveFreeBlock(start, block_size);
+		if (block_size > aligned_size) {
+			AddFreeBlock(start + aligned_size, block_size - aligned_size);
+		}
+	} else {
+		// grow the heap, free space never touches its end (see FreeFrame)
+		if (heap_end_ > UINT32_MAX - aligned_size) {
+			throw std::runtime_error(
+			    "Cannot allocate a frame of " + to_string(size) +
+			    " elements, the heap would grow past 2^32 elements");
+		}
+		start = heap_end_;
+		heap_end_ = start + aligned_size;
+	}
+
+	auto* new_frame = new Frame();
+	new_frame->start = start;
+	new_frame->size = size;
+	new_frame->end = start + size;
+	Frames_[start] = new_frame;
+
+	return new_frame;
+}
+
+pair<uint32_t, uint32_t> FrameAllocator::FreeFrame(Frame* frame) {
+	auto frame_it = Frames_.find(frame->start);
+	if (frame_it == Frames_.end()) {
+		return {0, 0};
+	}
+	uint32_t start = frame->start;
+	uint32_t size = GetAlignedSize(frame->size);
+	Frames_.erase(frame_it);
+	delete frame;
+
+	// merge with the free neighbours
+	auto next = free_by_start_.lower_bound(start);
+	if (next != free_by_start_.end() && next->first == start + size) {
+		size += next->second;
+		RemoveFreeBlock(next->first, next->second);
+	}
+	next = free_by_start_.lower_bound(start);
+	if (next != free_by_start_.begin()) {
+		auto prev = std::prev(next);
+		if (prev->first + prev->second == start) {
+			start = prev->first;
+			size += prev->second;
+			RemoveFreeBlock(prev->first, prev->second);
+		}
+	}
+
+	// free space at the end of the heap is given back
+	if (start + size == heap_end_) {
+		heap_end_ = start;
+	} else {
+		AddFreeBlock(start, size);
+	}
+	return {start, start + size};
+}
+
+FrameAllocatorStats FrameAllocator::GetStats() const {
+	FrameAllocatorStats stats;
+	stats.heap_size = heap_end_;
+	stats.frame_count = (uint32_t)Frames_.size();
+	stats.free_block_count = (uint32_t)free_by_start_.size();
+	for (auto& block : free_by_start_) {
+		stats.free_size += block.second;
+	}
+	if (!free_by_size_.empty()) {
+		stats.largest_free_block = std::prev(free_by_size_.end())->first;
+	}
+	stats.allocated_size = heap_end_ - stats.free_size;
+	return stats;
+}
+
+FrameAllocator::~FrameAllocator() {
+	for (auto& pair : Frames_) {
+		delete pair.second;
+	}
+}
+
+}  // namespace TensorFrost
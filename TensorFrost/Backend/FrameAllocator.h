@@ -4,6 +4,7 @@
 #include <functional>
 #include <iostream>
 #include <map>
+#include <set>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -19,50 +20,69 @@ class Frame {
 	uint32_t end;
 };
 
+class FrameAllocatorStats {
+ public:
+	uint32_t heap_size = 0;       // end of the used address range
+	uint32_t allocated_size = 0;  // sum of aligned live frame sizes
+	uint32_t free_size = 0;       // free space inside the heap
+	uint32_t largest_free_block = 0;
+	uint32_t free_block_count = 0;
+	uint32_t frame_count = 0;
+
+	// 0 when all free space is one block, close to 1 when it is scattered
+	[[nodiscard]] float GetFragmentation() const {
+		if (free_size == 0) return 0.0f;
+		return 1.0f - (float)largest_free_block / (float)free_size;
+	}
+};
+
+// Best-fit allocator over a linear address range, in uint32 elements.
+// Free blocks are indexed both by size (for best-fit lookup) and by address
+// (for coalescing with neighbours), so allocating and freeing are O(log n).
 class FrameAllocator {
  private:
 	std::map<uint32_t, Frame*> Frames_;
+	// free blocks as start -> size and as (size, start)
+	std::map<uint32_t, uint32_t> free_by_start_;
+	std::set<pair<uint32_t, uint32_t>> free_by_size_;
+	uint32_t heap_end_ = 0;
+
+	void AddFreeBlock(uint32_t start, uint32_t size);
+	void RemoveFreeBlock(uint32_t start, uint32_t size);
 
  public:
+	// frames are aligned to 64 bytes (16 elements) for SIMD loads and to keep
+	// separate buffers off the same cache line
+	static constexpr uint32_t kAlignment = 16;
+
 	FrameAllocator() = default;
+	FrameAllocator(const FrameAllocator&) = delete;
+	FrameAllocator& operator=(const FrameAllocator&) = delete;
 
 	// Frame iterator
 	using iterator = typename std::map<uint32_t, Frame*>::iterator;
 	iterator begin() { return Frames_.begin(); }
 	iterator end() { return Frames_.end(); }
 
-	Frame* AllocateFrame(uint32_t size) {
-		uint32_t start = 0;
-		for (auto& pair : Frames_) {
-			Frame* frame = pair.second;
-			if (frame->start - start >= size) {
-				// Found a free available slot
-				break;
-			}
-			start = frame->end;
-		}
-
-		auto* new_frame = new Frame();
-		new_frame->start = start;
-		new_frame->size = size;
-		new_frame->end = start + size;
-		Frames_[start] = new_frame;
-
-		return new_frame;
+	static uint32_t GetAlignedSize(uint32_t size) {
+		// empty frames still take a slot so their start is unique
+		size = std::max(size, 1u);
+		return (size + kAlignment - 1) / kAlignment * kAlignment;
 	}
 
-	void FreeFrame(Frame frame) {
-		auto it = Frames_.find(frame.start);
-		if (it != Frames_.end()) {
-			Frames_.erase(it);
-		}
-	}
+	// throws if the frame doesn't fit in the 2^32 element address range
+	Frame* AllocateFrame(uint32_t size);
+	// returns the free range [start, end) the frame ended up in after merging
+	// with its neighbours, or past the end of the heap if it was given back
+	pair<uint32_t, uint32_t> FreeFrame(Frame* frame);
 
 	[[nodiscard]] uint32_t GetRequiredAllocatedStorage() const {
-		if (Frames_.empty()) return 0;
-		// Get the end of the last frame in the sorted map
-		return std::prev(Frames_.end())->second->end;
+		return heap_end_;
 	}
+
+	[[nodiscard]] FrameAllocatorStats GetStats() const;
+
+	~FrameAllocator();
 };
 
-}  // namespace TensorFrost
\ No newline at end of file
+}  // namespace TensorFrost
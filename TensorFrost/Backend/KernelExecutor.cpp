@@ -1,3 +1,299 @@
 #include "KernelExecutor.h"
 
-namespace TensorFrost {}  // namespace TensorFrost
\ No newline at end of file
+#include <climits>
+
+namespace TensorFrost {
+
+bool kernel_concurrency = true;
+bool kernel_specialization = false;
+
+// place each step one level after the last step it depends on, a step
+// depends on earlier steps that write what it reads or writes, or that read
+// what it writes
+void PlanLevels(ExecutionPlan* plan) {
+	map<int, int> last_write_level;  // slot -> level of its last writer
+	map<int, int> last_read_level;   // slot -> highest level reading it
+	int level_count = 0;
+	for (PlanStep& step : plan->steps) {
+		int level = 0;
+		for (int slot : step.read_slots) {
+			if (last_write_level.contains(slot)) {
+				level = std::max(level, last_write_level[slot] + 1);
+			}
+		}
+		for (int slot : step.write_slots) {
+			if (last_write_level.contains(slot)) {
+				level = std::max(level, last_write_level[slot] + 1);
+			}
+			if (last_read_level.contains(slot)) {
+				level = std::max(level, last_read_level[slot] + 1);
+			}
+		}
+		step.level = level;
+		for (int slot : step.read_slots) {
+			last_read_level[slot] = std::max(last_read_level[slot], level);
+		}
+		for (int slot : step.write_slots) {
+			last_write_level[slot] = level;
+		}
+		level_count = std::max(level_count, level + 1);
+	}
+
+	// stable bucketing keeps program order inside a level
+	plan->level_begin.assign(level_count + 1, 0);
+	for (PlanStep& step : plan->steps) {
+		plan->level_begin[step.level + 1]++;
+	}
+	for (int i = 0; i < level_count; i++) {
+		plan->level_begin[i + 1] += plan->level_begin[i];
+	}
+	plan->level_steps.resize(plan->steps.size());
+	vector<int> fill = plan->level_begin;
+	for (int i = 0; i < plan->steps.size(); i++) {
+		plan->level_steps[fill[plan->steps[i].level]++] = i;
+	}
+}
+
+// assign intermediate buffers to arena groups based on their lifetimes
+void PlanArena(ExecutionPlan* plan) {
+	map<int, PlanBuffer*> buffer_of_slot;
+	for (int i = 0; i < plan->steps.size(); i++) {
+		PlanStep& step = plan->steps[i];
+		if (step.type != KernelType::Memory || step.is_output) {
+			continue;
+		}
+		// shapes are constants or input dimensions, so the arena can be sized
+		// before running
+		step.in_arena = true;
+		PlanBuffer buffer;
+		buffer.memory_slot = step.memory_slot;
+		buffer.shape = step.shape;
+		buffer.first_use = i;
+		buffer.last_use = i;
+		buffer.first_level = INT_MAX;
+		buffer.last_level = step.level;
+		plan->arena_buffers.push_back(buffer);
+	}
+
+	for (auto& buffer : plan->arena_buffers) {
+		buffer_of_slot[buffer.memory_slot] = &buffer;
+	}
+
+	// find the kernels that touch each buffer
+	for (int i = 0; i < plan->steps.size(); i++) {
+		PlanStep& step = plan->steps[i];
+		auto use_slot = [&](int slot) {
+			if (buffer_of_slot.contains(slot)) {
+				PlanBuffer* buffer = buffer_of_slot[slot];
+				buffer->last_use = i;
+				buffer->first_level = std::min(buffer->first_level, step.level);
+				buffer->last_level = std::max(buffer->last_level, step.level);
+			}
+		};
+		for (int slot : step.memory_slots) use_slot(slot);
+		auto use_value = [&](const PlanValue& value) {
+			if (value.source == PlanValue::Source::Memory) {
+				use_slot(value.value);
+			}
+		};
+		for (auto& variable : step.variables) use_value(variable);
+	}
+	for (auto& buffer : plan->arena_buffers) {
+		// never used by a kernel
+		buffer.first_level = std::min(buffer.first_level, buffer.last_level);
+	}
+
+	// greedy interval coloring in allocation order, preferring a free group
+	// whose buffers have the same (possibly symbolic) shape. A group is free
+	// once its buffers are dead both in program order and in level order, so
+	// the assignment holds whether or not kernels run concurrently.
+	vector<int> group_end;
+	vector<int> group_end_level;
+	vector<vector<PlanValue>> group_shape;
+	auto same_shape = [](const vector<PlanValue>& a, const vector<PlanValue>& b) {
+		if (a.size() != b.size()) return false;
+		for (int i = 0; i < a.size(); i++) {
+			if (a[i].source != b[i].source || a[i].value != b[i].value) {
+				return false;
+			}
+		}
+		return true;
+	};
+	for (auto& buffer : plan->arena_buffers) {
+		int chosen = -1;
+		for (int g = 0; g < group_end.size(); g++) {
+			if (group_end[g] >= buffer.first_use ||
+			    group_end_level[g] >= buffer.first_level) {
+				continue;
+			}
+			if (chosen == -1 || same_shape(group_shape[g], buffer.shape)) {
+				chosen = g;
+			}
+			if (same_shape(group_shape[g], buffer.shape)) {
+				break;
+			}
+		}
+		if (chosen == -1) {
+			chosen = (int)group_end.size();
+			group_end.push_back(0);
+			group_end_level.push_back(0);
+			group_shape.push_back(buffer.shape);
+		}
+		group_end[chosen] = buffer.last_use;
+		group_end_level[chosen] = buffer.last_level;
+		buffer.group = chosen;
+	}
+	plan->arena_group_count = (int)group_end.size();
+}
+
+ExecutionPlan* GenerateExecutionPlan(Program* program) {
+	auto* plan = new ExecutionPlan(program);
+
+	map<Node*, int> memory_slots;
+	map<Node*, int> shape_slots;
+
+	auto get_memory_slot = [&](Node* node) {
+		if (!memory_slots.contains(node)) {
+			memory_slots[node] = plan->memory_slot_count++;
+		}
+		return memory_slots[node];
+	};
+
+	auto get_shape_slot = [&](Node* node) {
+		if (!shape_slots.contains(node)) {
+			shape_slots[node] = plan->shape_slot_count++;
+		}
+		return shape_slots[node];
+	};
+
+	// shape values are either constants or dynamic input dimensions
+	auto get_shape_value = [&](Node* node) {
+		if (node->name == "const") {
+			return PlanValue(PlanValue::Source::Constant,
+			                 node->GetTensor()->data[0]);
+		}
+		return PlanValue(PlanValue::Source::Shape, get_shape_slot(node));
+	};
+
+	for (auto node = program->ir_->begin(); !node.is_end(); ++node) {
+		if (node->memory_type_ != MemoryType::Input) {
+			continue;
+		}
+		PlanInput input;
+		input.memory_slot = get_memory_slot(*node);
+		Arguments args = node->GetArguments(Arg::Shape);
+		for (int j = 0; j < args.size(); j++) {
+			Node* shape_node = args[j].from_->get();
+			if (shape_node->name == "const") {
+				input.checked_dims.emplace_back(j, shape_node->GetTensor()->data[0]);
+			}
+			input.shape_slots.emplace_back(j, get_shape_slot(shape_node));
+		}
+		plan->inputs.push_back(input);
+	}
+
+	map<int, int> output_slots;
+	for (auto& i : program->kernels_) {
+		Kernel* kernel = &i;
+		PlanStep step;
+		step.kernel = kernel;
+		step.type = kernel->type_;
+
+		switch (kernel->type_) {
+			case KernelType::Memory: {
+				Node* node = kernel->begin_;
+				ArgMap args = node->GetArgumentMap(Arg::Shape);
+				uint dims = MaxIndexCount(args);
+				for (int d = 0; d < dims; d++) {
+					step.shape.push_back(get_shape_value(args[d]->from_->get()));
+				}
+				step.memory_slot = get_memory_slot(node);
+				step.write_slots.push_back(step.memory_slot);
+				step.is_output = node->memory_type_ == MemoryType::Output;
+				if (step.is_output) {
+					output_slots[node->memory_index_] = step.memory_slot;
+				}
+			} break;
+			case KernelType::Compute: {
+				for (int d = 0; d < kernel->dim; d++) {
+					step.shape.push_back(get_shape_value(kernel->shape[d]->from_->get()));
+				}
+				step.linear = kernel->indexing_mode_ == KernelIndexingMode::Linear;
+
+				step.memory_slots.resize(kernel->memory.size());
+				for (auto& j : kernel->memory) {
+					step.memory_slots[j.second] = get_memory_slot(j.first);
+				}
+
+				step.variables.resize(kernel->variables.size());
+				for (auto& j : kernel->variables) {
+					Node* variable = j.first;
+					if (variable->name == "const") {
+						step.variables[j.second] = PlanValue(
+						    PlanValue::Source::Constant, variable->GetTensor()->data[0]);
+					} else if (shape_slots.contains(variable)) {
+						step.variables[j.second] =
+						    PlanValue(PlanValue::Source::Shape, shape_slots[variable]);
+					} else {
+						// otherwise, load variable from memory
+						step.variables[j.second] = PlanValue(
+						    PlanValue::Source::Memory, get_memory_slot(variable));
+					}
+				}
+
+				// loads read memory, stores and scatters write it
+				Lable* cluster = kernel->begin_->cluster_head_;
+				step.repeatable = true;
+				for (auto node = IR::Iterator(cluster->node_);
+				     !node.is_cluster_end(cluster); ++node) {
+					step.cost += node->op->GetCost();
+					if (node->op->op_type_ == OpType::Scatter) {
+						step.repeatable = false;
+					}
+					for (const Arg& arg : node->GetArguments(Arg::Type::Memory)) {
+						int slot = get_memory_slot(arg.from_->get());
+						if (node->op->op_type_ == OpType::Load) {
+							step.read_slots.push_back(slot);
+						} else {
+							step.write_slots.push_back(slot);
+						}
+					}
+				}
+
+				for (int slot : step.write_slots) {
+					if (std::find(step.read_slots.begin(), step.read_slots.end(),
+					              slot) != step.read_slots.end()) {
+						step.repeatable = false;
+					}
+				}
+
+				step.argument_offset = plan->argument_count;
+				plan->argument_count += (int)(step.variables.size() +
+				                              step.memory_slots.size() +
+				                              step.shape.size() +
+				                              kernel->tile_size.size());
+			} break;
+		}
+
+		// values read on the host when the step starts
+		for (auto& value : step.variables) {
+			if (value.source == PlanValue::Source::Memory) {
+				step.read_slots.push_back((int)value.value);
+			}
+		}
+
+		plan->steps.push_back(step);
+	}
+
+	for (auto& output : output_slots) {
+		plan->outputs.push_back(output.second);
+	}
+
+	PlanLevels(plan);
+	PlanArena(plan);
+	plan->profile.steps.resize(plan->steps.size());
+
+	return plan;
+}
+
+}  // namespace TensorFrost
@@ -1,18 +1,179 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
 #include <functional>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include "IR/KernelGen.h"
+#include "Profiler.h"
 #include "TensorMemory.h"
+#include "Utility/Trace.h"
 
 namespace TensorFrost {
 
 using namespace std;
 
-}  // namespace TensorFrost
\ No newline at end of file
+// Flat, index based description of how to run a program, resolved once when
+// the program is built so that execution does no graph walking or map lookups.
+
+// where a scalar kernel argument (shape or variable) comes from at runtime
+class PlanValue {
+ public:
+	enum class Source {
+		Constant,  // value is known at build time
+		Shape,     // value is an input shape, stored in a shape slot
+		Memory,    // value is loaded from the first element of a memory slot,
+		           // only kernel variables, shapes are never data dependent
+	};
+
+	Source source = Source::Constant;
+	uint value = 0;  // constant value or slot index
+
+	PlanValue() = default;
+	PlanValue(Source source, uint value) : source(source), value(value) {}
+};
+
+class PlanInput {
+ public:
+	int memory_slot = 0;
+	// input shape dimensions that must match a constant
+	vector<pair<int, int>> checked_dims;
+	// input shape dimensions stored as dynamic shape values
+	vector<pair<int, int>> shape_slots;
+};
+
+class PlanStep {
+ public:
+	Kernel* kernel = nullptr;
+	KernelType type = KernelType::Compute;
+
+	// memory kernels: allocated shape and destination slot
+	vector<PlanValue> shape;
+	int memory_slot = 0;
+	bool is_output = false;
+	// intermediate buffers are placed in the shared arena instead
+	bool in_arena = false;
+
+	// compute kernels: bound memory slots and variables, in kernel order
+	vector<int> memory_slots;
+	vector<PlanValue> variables;
+	bool linear = false;
+	// summed cost of the kernel's operations per thread, a static estimate
+	float cost = 0.0F;
+	// start of this step's arguments in the argument buffer
+	int argument_offset = 0;
+
+	// memory slots read and written, used to order the steps
+	vector<int> read_slots;
+	vector<int> write_slots;
+	// steps in the same level don't depend on each other
+	int level = 0;
+	// running the step again gives the same result (no atomics and no buffer
+	// both read and written), so the autotuner may launch it several times
+	bool repeatable = false;
+};
+
+// kernels compiled for one set of input shapes, see kernel_specialization
+class ShapeVariant {
+ public:
+	// set by the builder thread once the kernels can be used
+	std::atomic<bool> ready = false;
+	// entry points of the compute steps, indexed by step
+	vector<KernelRangeCallback> kernels;
+	function<void()> unload_callback;
+	std::thread builder;
+
+	~ShapeVariant() {
+		if (builder.joinable()) {
+			builder.join();
+		}
+		if (unload_callback) {
+			unload_callback();
+		}
+	}
+};
+
+// intermediate buffer placed in the arena, buffers whose lifetimes do not
+// overlap share a group and therefore the same arena region
+class PlanBuffer {
+ public:
+	int memory_slot = 0;
+	vector<PlanValue> shape;
+	int group = 0;
+	// lifetime in step order and in level order
+	int first_use = 0;
+	int last_use = 0;
+	int first_level = 0;
+	int last_level = 0;
+};
+
+class ExecutionPlan {
+ public:
+	Program* program;
+	vector<PlanInput> inputs;
+	vector<PlanStep> steps;
+	// memory slot of each output, ordered by output index
+	vector<int> outputs;
+	int memory_slot_count = 0;
+	int shape_slot_count = 0;
+	// total size of the variables + offsets + shape arguments of all steps
+	int argument_count = 0;
+
+	// step indices grouped by level, level i is
+	// level_steps[level_begin[i] .. level_begin[i + 1])
+	vector<int> level_steps;
+	vector<int> level_begin;
+
+	vector<PlanBuffer> arena_buffers;
+	int arena_group_count = 0;
+	// kept between calls so intermediates are not reallocated every time
+	TensorMemory* arena = nullptr;
+	std::mutex arena_mutex;
+
+	// filled while kernel_profiling is enabled
+	ProgramProfile profile;
+
+	// size bucket of the input shapes the kernels are tuned for, see
+	// kernel_autotuning. The mutex guards these and the kernels' launch
+	// configurations, it is never held while kernels run. One run at a time
+	// tunes (autotuning), on its own copy of the configurations.
+	bool autotuned = false;
+	bool autotuning = false;
+	vector<uint> autotune_bucket;
+	std::shared_mutex autotune_mutex;
+
+	// shape specialized kernels by input shapes and tile sizes, destroyed
+	// with the plan, before the program they were generated from
+	map<vector<uint>, unique_ptr<ShapeVariant>> shape_variants;
+	std::mutex shape_variants_mutex;
+
+	explicit ExecutionPlan(Program* program) : program(program) {}
+
+	~ExecutionPlan() { delete arena; }
+};
+
+// compile kernels specialized for the shapes of each new set of input shapes
+// in the background, they replace the generic kernels once built
+extern bool kernel_specialization;
+// shape sets specialized per program, later new ones use the generic kernels
+constexpr size_t kMaxShapeVariants = 16;
+
+// run independent kernels of a level together instead of one by one in
+// program order, can be turned off for deterministic debugging
+extern bool kernel_concurrency;
+
+// elements per arena group are rounded up to this (64 bytes)
+constexpr uint kArenaAlignment = 16;
+
+ExecutionPlan* GenerateExecutionPlan(Program* program);
+
+}  // namespace TensorFrost
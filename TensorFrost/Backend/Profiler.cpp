@@ -0,0 +1,49 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace TensorFrost {
+
+bool kernel_profiling = false;
+
+void KernelProfile::AddSample(double time, uint64_t threads, uint64_t bytes,
+                              const PerfCounterValues& counters) {
+	if (calls == 0) {
+		min_time = time;
+		max_time = time;
+	} else {
+		min_time = std::min(min_time, time);
+		max_time = std::max(max_time, time);
+	}
+	if (samples.size() < kProfileSampleCount) {
+		samples.push_back((float)time);
+	} else {
+		samples[calls % kProfileSampleCount] = (float)time;
+	}
+	calls++;
+	total_time += time;
+	this->threads = threads;
+	this->bytes = bytes;
+	this->counters.Add(counters);
+}
+
+double KernelProfile::GetPercentile(double percentile) const {
+	if (samples.empty()) {
+		return 0.0;
+	}
+	vector<float> sorted = samples;
+	size_t index = (size_t)std::ceil(percentile / 100.0 * sorted.size());
+	index = std::min(std::max(index, (size_t)1), sorted.size()) - 1;
+	std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+	return sorted[index];
+}
+
+void ProgramProfile::Reset() {
+	std::lock_guard<std::mutex> lock(mutex);
+	for (KernelProfile& step : steps) {
+		step = KernelProfile();
+	}
+}
+
+}  // namespace TensorFrost
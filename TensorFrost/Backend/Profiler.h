@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "Backends/CPU/PerfCounters.h"
+
+namespace TensorFrost {
+
+using namespace std;
+
+// time every kernel launch, kernels then run one by one in program order so
+// that each measurement belongs to a single kernel
+extern bool kernel_profiling;
+
+// recent launch times kept per kernel for the percentiles
+constexpr size_t kProfileSampleCount = 1024;
+
+// launch statistics of one kernel since the last reset, times in milliseconds
+class KernelProfile {
+ public:
+	uint64_t calls = 0;
+	double total_time = 0.0;
+	double min_time = 0.0;
+	double max_time = 0.0;
+	// work items and bytes of the bound buffers of the last launch
+	uint64_t threads = 0;
+	uint64_t bytes = 0;
+	// ring buffer of the last kProfileSampleCount launch times
+	vector<float> samples;
+	// summed over all launches, if kernel_hardware_counters was enabled
+	PerfCounterValues counters;
+
+	void AddSample(double time, uint64_t threads, uint64_t bytes,
+	               const PerfCounterValues& counters);
+	[[nodiscard]] double GetPercentile(double percentile) const;
+	[[nodiscard]] double GetMeanTime() const {
+		return calls == 0 ? 0.0 : total_time / (double)calls;
+	}
+};
+
+// per step profiles of an execution plan, only compute steps are filled
+class ProgramProfile {
+ public:
+	vector<KernelProfile> steps;
+	std::mutex mutex;
+
+	void Reset();
+};
+
+}  // namespace TensorFrost
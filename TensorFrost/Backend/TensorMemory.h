@@ -4,6 +4,7 @@
 #include <functional>
 #include <iostream>
 #include <map>
+#include <mutex>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -23,6 +24,8 @@ class TensorMemoryManager {
  public:
 	FrameAllocator allocator;
 	map<Frame*, TensorMemory*> allocated;
+	// programs can run outside the GIL, so allocation must be thread safe
+	mutable std::mutex mutex;
 
 	virtual TensorMemory* Allocate(const vector<int>& shape) = 0;
 	virtual TensorMemory* AllocateWithData(const vector<int>& shape,
@@ -31,9 +34,15 @@ class TensorMemoryManager {
 	virtual void Free(TensorMemory* memory) = 0;
 
 	[[nodiscard]] uint32_t GetAllocatedSize() const {
+		std::lock_guard<std::mutex> lock(mutex);
 		return allocator.GetRequiredAllocatedStorage();
 	}
 
+	[[nodiscard]] FrameAllocatorStats GetAllocatorStats() const {
+		std::lock_guard<std::mutex> lock(mutex);
+		return allocator.GetStats();
+	}
+
 	virtual ~TensorMemoryManager() = default;
 };
 
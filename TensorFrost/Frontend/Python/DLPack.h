@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+
+// Minimal subset of the DLPack ABI (https://github.com/dmlc/dlpack, v0.8),
+// enough to exchange CPU tensors with numpy, torch and others.
+
+extern "C" {
+
+typedef enum {
+	kDLCPU = 1,
+} DLDeviceType;
+
+typedef struct {
+	int32_t device_type;
+	int32_t device_id;
+} DLDevice;
+
+typedef enum {
+	kDLInt = 0U,
+	kDLUInt = 1U,
+	kDLFloat = 2U,
+} DLDataTypeCode;
+
+typedef struct {
+	uint8_t code;
+	uint8_t bits;
+	uint16_t lanes;
+} DLDataType;
+
+typedef struct {
+	void* data;
+	DLDevice device;
+	int32_t ndim;
+	DLDataType dtype;
+	int64_t* shape;
+	int64_t* strides;
+	uint64_t byte_offset;
+} DLTensor;
+
+typedef struct DLManagedTensor {
+	DLTensor dl_tensor;
+	void* manager_ctx;
+	void (*deleter)(struct DLManagedTensor* self);
+} DLManagedTensor;
+
+}
@@ -1,10 +1,59 @@
+#include <cstring>
 #include <utility>
 #include <vector>
 
+#include <Frontend/Python/DLPack.h>
 #include <Frontend/Python/PyTensor.h>
 
 namespace TensorFrost {
 
+// pointer to the tensor data if it lives in host memory, nullptr otherwise
+uint* GetHostData(const TensorMemory& t) {
+	auto* cpu_memory_manager = dynamic_cast<CpuMemoryManager*>(t.manager);
+	if (cpu_memory_manager == nullptr) {
+		return nullptr;
+	}
+	return cpu_memory_manager->GetData(&t);
+}
+
+TensorMemory* AllocateFromHost(const std::vector<int>& shape, const void* data) {
+	TensorMemory* memory = global_memory_manager->Allocate(shape);
+	size_t size = memory->GetSize();
+	uint* dst = GetHostData(*memory);
+	if (dst != nullptr) {
+		memcpy(dst, data, size * sizeof(uint));
+	} else {
+		std::vector<uint> staging(size);
+		memcpy(staging.data(), data, size * sizeof(uint));
+		delete memory;
+		memory = global_memory_manager->AllocateWithData(shape, staging);
+	}
+	return memory;
+}
+
+// keeps the python TensorMemory alive while a DLPack consumer uses its data
+struct DLPackContext {
+	DLManagedTensor tensor;
+	std::vector<int64_t> shape;
+	PyObject* owner;
+};
+
+void DLPackDeleter(DLManagedTensor* self) {
+	auto* context = static_cast<DLPackContext*>(self->manager_ctx);
+	py::gil_scoped_acquire acquire;
+	Py_DECREF(context->owner);
+	delete context;
+}
+
+void DLPackCapsuleDestructor(PyObject* capsule) {
+	// the capsule was never consumed, so it still owns the tensor
+	if (PyCapsule_IsValid(capsule, "dltensor")) {
+		auto* tensor =
+		    static_cast<DLManagedTensor*>(PyCapsule_GetPointer(capsule, "dltensor"));
+		tensor->deleter(tensor);
+	}
+}
+
 void TensorMemoryDefinition(py::module& m,
                             py::class_<TensorMemory>& py_tensor_mem) {
 	// "constructor"
@@ -15,35 +64,63 @@ void TensorMemoryDefinition(py::module& m,
 	    },
 	    "Create a TensorMemory with the given shape");
 
-	// "constructor" from numpy array
+	// "constructor" from numpy array, a single copy into the managed heap
 	m.def(
 	    "memory",
-	    [](const py::array_t<float>& arr) {
-		    // get the shape
-		    std::vector<int> shape;
-		    py::buffer_info info = arr.request();
-		    int size = 1;
-		    shape.resize(info.ndim);
-		    for (int i = 0; i < info.ndim; i++) 
-			{
-			    shape[i] = (int)info.shape[i];
-			    size *= shape[i];
+	    [](const py::array_t<float, py::array::c_style | py::array::forcecast>&
+	           arr) {
+		    std::vector<int> shape(arr.ndim());
+		    for (int i = 0; i < arr.ndim(); i++) {
+			    shape[i] = (int)arr.shape(i);
 		    }
+		    return AllocateFromHost(shape, arr.data());
+	    },
+	    "Create a TensorMemory from a numpy array");
 
-		    // create the data vector
-		    std::vector<uint> data;
-
-		    // copy the data
-		    auto* ptr = static_cast<float*>(info.ptr);
-		    data.reserve(size);
-		    for (int i = 0; i < size; i++) {
-			    data.push_back(*(reinterpret_cast<uint*>(&ptr[i])));
+	// "constructor" from any object supporting DLPack
+	m.def(
+	    "from_dlpack",
+	    [](const py::object& obj) {
+		    py::capsule capsule = obj.attr("__dlpack__")();
+		    if (!PyCapsule_IsValid(capsule.ptr(), "dltensor")) {
+			    throw std::runtime_error("Invalid or already consumed DLPack capsule");
+		    }
+		    auto* managed = static_cast<DLManagedTensor*>(
+		        PyCapsule_GetPointer(capsule.ptr(), "dltensor"));
+		    const DLTensor& dl = managed->dl_tensor;
+		    if (dl.device.device_type != kDLCPU) {
+			    throw std::runtime_error("Only CPU DLPack tensors are supported");
+		    }
+		    // the data is copied as is, so integers would be read as float bits
+		    if (dl.dtype.code != kDLFloat || dl.dtype.bits != 32 ||
+		        dl.dtype.lanes != 1) {
+			    throw std::runtime_error(
+			        "Only float32 DLPack tensors are supported, convert the tensor "
+			        "to float32 first");
+		    }
+		    std::vector<int> shape(dl.ndim);
+		    int64_t expected_stride = 1;
+		    for (int i = dl.ndim - 1; i >= 0; i--) {
+			    shape[i] = (int)dl.shape[i];
+			    if (dl.strides != nullptr && dl.shape[i] != 1 &&
+			        dl.strides[i] != expected_stride) {
+				    throw std::runtime_error(
+				        "Only contiguous DLPack tensors are supported");
+			    }
+			    expected_stride *= dl.shape[i];
 		    }
 
-		    // allocate the memory
-		    return global_memory_manager->AllocateWithData(shape, data);
+		    TensorMemory* memory = AllocateFromHost(
+		        shape, static_cast<char*>(dl.data) + dl.byte_offset);
+
+		    // mark the capsule as consumed and release the producer's tensor
+		    PyCapsule_SetName(capsule.ptr(), "used_dltensor");
+		    if (managed->deleter != nullptr) {
+			    managed->deleter(managed);
+		    }
+		    return memory;
 	    },
-	    "Create a TensorMemory from a numpy array");
+	    "Create a TensorMemory from a DLPack compatible tensor");
 
 	// properties
 	py_tensor_mem.def_property_readonly("shape", [](const TensorMemory& t) {
@@ -51,27 +128,99 @@ void TensorMemoryDefinition(py::module& m,
 		return py::make_tuple(shape);
 	});
 
-	// to numpy array
+	// numpy array viewing the tensor memory, keeps the TensorMemory alive
 	py_tensor_mem.def_property_readonly(
 	    "numpy",
-	    [](const TensorMemory& t) {
-		    // create the numpy array
-			py::array_t<float> arr(t.GetShape());
-			
-		    // copy the data
-		    std::vector<uint> data = global_memory_manager->Readback(&t);
-		    float* ptr = static_cast<float*>(arr.request().ptr);
-		    for (int i = 0; i < data.size(); i++) {
-			    ptr[i] = *(reinterpret_cast<float*>(&data[i]));
+	    [](const py::object& self) {
+		    const auto& t = self.cast<const TensorMemory&>();
+		    uint* data = GetHostData(t);
+		    if (data != nullptr) {
+			    return py::array_t<float>(t.GetShape(),
+			                              reinterpret_cast<float*>(data), self);
 		    }
 
+		    // not in host memory, read it back
+		    py::array_t<float> arr(t.GetShape());
+		    std::vector<uint> readback = global_memory_manager->Readback(&t);
+		    memcpy(arr.mutable_data(), readback.data(),
+		           readback.size() * sizeof(uint));
 		    return arr;
 	    },
-	    "Readback data from tensor memory to a numpy array");
+	    "View the tensor memory as a numpy array");
+
+	// python buffer protocol, memoryview(t) and np.asarray(t) do not copy
+	py_tensor_mem.def_buffer([](TensorMemory& t) -> py::buffer_info {
+		uint* data = GetHostData(t);
+		if (data == nullptr) {
+			throw std::runtime_error("TensorMemory is not in host memory");
+		}
+		std::vector<py::ssize_t> shape(t.shape.begin(), t.shape.end());
+		std::vector<py::ssize_t> strides(shape.size());
+		py::ssize_t stride = sizeof(float);
+		for (int i = (int)shape.size() - 1; i >= 0; i--) {
+			strides[i] = stride;
+			stride *= shape[i];
+		}
+		return py::buffer_info(data, sizeof(float),
+		                       py::format_descriptor<float>::format(),
+		                       (py::ssize_t)shape.size(), shape, strides);
+	});
+
+	py_tensor_mem.def(
+	    "__dlpack__",
+	    [](const py::object& self, const py::object& /*stream*/) {
+		    const auto& t = self.cast<const TensorMemory&>();
+		    uint* data = GetHostData(t);
+		    if (data == nullptr) {
+			    throw std::runtime_error("TensorMemory is not in host memory");
+		    }
+
+		    auto* context = new DLPackContext();
+		    context->shape.assign(t.shape.begin(), t.shape.end());
+		    context->owner = self.ptr();
+		    Py_INCREF(context->owner);
+
+		    DLTensor& dl = context->tensor.dl_tensor;
+		    dl.data = data;
+		    dl.device = {kDLCPU, 0};
+		    dl.ndim = (int32_t)context->shape.size();
+		    dl.dtype = {kDLFloat, 32, 1};
+		    dl.shape = context->shape.data();
+		    dl.strides = nullptr;  // compact row major
+		    dl.byte_offset = 0;
+		    context->tensor.manager_ctx = context;
+		    context->tensor.deleter = DLPackDeleter;
+
+		    return py::capsule(&context->tensor, "dltensor",
+		                       DLPackCapsuleDestructor);
+	    },
+	    py::arg("stream") = py::none(),
+	    "Export the tensor memory as a DLPack capsule without copying");
+
+	py_tensor_mem.def("__dlpack_device__", [](const TensorMemory&) {
+		return py::make_tuple((int)kDLCPU, 0);
+	});
 
 	m.def(
 	    "used_memory", []() { return global_memory_manager->GetAllocatedSize(); },
 	    "Get the amount of memory currently used by the memory manager");
+
+	m.def(
+	    "memory_stats",
+	    []() {
+		    FrameAllocatorStats stats = global_memory_manager->GetAllocatorStats();
+		    py::dict result;
+		    result["heap_size"] = stats.heap_size;
+		    result["allocated_size"] = stats.allocated_size;
+		    result["free_size"] = stats.free_size;
+		    result["largest_free_block"] = stats.largest_free_block;
+		    result["free_block_count"] = stats.free_block_count;
+		    result["frame_count"] = stats.frame_count;
+		    result["fragmentation"] = stats.GetFragmentation();
+		    return result;
+	    },
+	    "Get allocator statistics (sizes in 32 bit elements) and the "
+	    "fragmentation of the free space");
 }
 
-}  // namespace TensorFrost
\ No newline at end of file
+}  // namespace TensorFrost
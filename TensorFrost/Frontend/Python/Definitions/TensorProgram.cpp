@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <chrono>
+#include <future>
 #include <utility>
 #include <vector>
 
@@ -5,8 +8,133 @@
 
 namespace TensorFrost {
 
+py::tuple OutputsToTuple(const vector<TensorMemory*>& outputs) {
+	// output a tuple of tensor memories
+	py::tuple py_outputs = py::tuple(outputs.size());
+	for (size_t i = 0; i < outputs.size(); i++) {
+		py_outputs[i] =
+		    py::cast(outputs[i], py::return_value_policy::take_ownership);
+	}
+	return py_outputs;
+}
+
+py::tuple EvaluateProgram(TensorProgram& program, const py::tuple& py_inputs) {
+	vector<TensorMemory*> inputs = TensorMemoryFromTuple(py_inputs);
+	vector<TensorMemory*> outputs;
+	{
+		// kernels don't touch python objects, let other threads run
+		py::gil_scoped_release release;
+		outputs = program.Evaluate(inputs);
+	}
+	return OutputsToTuple(outputs);
+}
+
+// copies equally shaped tensors into one tensor with a leading batch dimension
+TensorMemory* StackTensorMemory(const vector<TensorMemory*>& memories) {
+	vector<int> shape = memories[0]->GetShape();
+	for (TensorMemory* memory : memories) {
+		if (memory->GetShape() != shape) {
+			throw std::runtime_error(
+			    "Cannot stack batch outputs with different shapes");
+		}
+	}
+	size_t size = memories[0]->GetSize();
+	shape.insert(shape.begin(), (int)memories.size());
+
+	vector<uint> data(size * memories.size());
+	for (size_t i = 0; i < memories.size(); i++) {
+		vector<uint> instance = global_memory_manager->Readback(memories[i]);
+		std::copy(instance.begin(), instance.end(), data.begin() + i * size);
+	}
+	return global_memory_manager->AllocateWithData(shape, data);
+}
+
+// totals of the counters that could be read, with the derived rates
+void AddCounterStatistics(py::dict& row, const PerfCounterValues& counters) {
+	const pair<PerfCounter, const char*> names[] = {
+	    {PerfCounter::Cycles, "cycles"},
+	    {PerfCounter::Instructions, "instructions"},
+	    {PerfCounter::CacheMisses, "llc_misses"},
+	    {PerfCounter::BranchMisses, "branch_misses"},
+	    {PerfCounter::TaskClock, "cpu_time_ns"},
+	    {PerfCounter::PageFaults, "page_faults"},
+	};
+	for (const auto& [counter, name] : names) {
+		if (counters.Has(counter)) {
+			row[name] = counters.Get(counter);
+		}
+	}
+
+	double instructions = (double)counters.Get(PerfCounter::Instructions);
+	if (!counters.Has(PerfCounter::Instructions) || instructions == 0.0) {
+		return;
+	}
+	if (counters.Has(PerfCounter::Cycles) &&
+	    counters.Get(PerfCounter::Cycles) != 0) {
+		row["ipc"] = instructions / (double)counters.Get(PerfCounter::Cycles);
+	}
+	// misses per thousand instructions
+	if (counters.Has(PerfCounter::CacheMisses)) {
+		row["llc_mpki"] =
+		    1000.0 * (double)counters.Get(PerfCounter::CacheMisses) / instructions;
+	}
+	if (counters.Has(PerfCounter::BranchMisses)) {
+		row["branch_mpki"] =
+		    1000.0 * (double)counters.Get(PerfCounter::BranchMisses) / instructions;
+	}
+}
+
+// handle to a program running on the execution queue
+class ProgramFuture {
+ public:
+	std::shared_future<vector<TensorMemory*>> future;
+	// the program and the inputs must outlive the execution
+	py::object keep_alive;
+	py::object outputs;
+
+	void Wait() const {
+		py::gil_scoped_release release;
+		future.wait();
+	}
+
+	[[nodiscard]] bool Done() const {
+		return future.wait_for(std::chrono::seconds(0)) ==
+		       std::future_status::ready;
+	}
+
+	py::object Result() {
+		if (!outputs) {
+			Wait();
+			outputs = OutputsToTuple(future.get());
+			keep_alive = py::none();
+		}
+		return outputs;
+	}
+
+	~ProgramFuture() {
+		if (outputs || !future.valid()) {
+			return;
+		}
+		// the result was never requested, free the outputs once done
+		try {
+			vector<TensorMemory*> unclaimed;
+			{
+				py::gil_scoped_release release;
+				unclaimed = future.get();
+			}
+			for (TensorMemory* memory : unclaimed) {
+				delete memory;
+			}
+		} catch (const std::exception&) {
+			// the error was never observed, nothing to free
+		}
+	}
+};
+
 void TensorProgramDefinition(py::module& m,
                              py::class_<TensorProgram>& tensor_program) {
+	auto program_future = py::class_<ProgramFuture>(m, "ProgramFuture");
+
 	m.def(
 	    "program",
 	    [](const py::function& py_evaluate) {
@@ -28,30 +156,129 @@ void TensorProgramDefinition(py::module& m,
 	tensor_program.def(
 	    "__call__",
 	    [](TensorProgram& program, py::args py_inputs) {
-		    vector<TensorMemory*> inputs = TensorMemoryFromTuple(py_inputs);
-		    vector<TensorMemory*> outputs = program.Evaluate(inputs);
-		    // output a tuple of tensor memories
-		    py::tuple py_outputs = py::tuple(outputs.size());
-		    for (size_t i = 0; i < outputs.size(); i++) {
-			    py_outputs[i] = py::cast(*outputs[i]);
-		    }
-		    return py_outputs;
+		    return EvaluateProgram(program, py_inputs);
 	    },
 	    "Evaluate the TensorProgram with the given inputs");
 
 	tensor_program.def(
 	    "__call__",
 	    [](TensorProgram& program, py::tuple py_inputs) {
+		    return EvaluateProgram(program, py_inputs);
+	    },
+	    "Evaluate the TensorProgram with the given inputs");
+
+	tensor_program.def(
+	    "batch",
+	    [](TensorProgram& program, const py::list& py_batch, bool stack) {
+		    vector<vector<TensorMemory*>> inputs;
+		    for (auto instance : py_batch) {
+			    inputs.push_back(TensorMemoryFromTuple(instance.cast<py::tuple>()));
+		    }
+		    // without instances there are no output shapes to stack, so an
+		    // empty batch stacks into an empty tuple
+		    if (inputs.empty()) {
+			    return stack ? py::object(py::tuple()) : py::object(py::list());
+		    }
+		    vector<vector<TensorMemory*>> outputs;
+		    {
+			    py::gil_scoped_release release;
+			    outputs = program.EvaluateBatch(inputs);
+		    }
+
+		    if (!stack) {
+			    py::list py_outputs;
+			    for (auto& instance_outputs : outputs) {
+				    py_outputs.append(OutputsToTuple(instance_outputs));
+			    }
+			    return py::object(py_outputs);
+		    }
+
+		    // one tensor per output, with the batch as the leading dimension
+		    vector<TensorMemory*> stacked;
+		    try {
+			    for (size_t j = 0; j < outputs[0].size(); j++) {
+				    vector<TensorMemory*> column;
+				    for (auto& instance_outputs : outputs) {
+					    column.push_back(instance_outputs[j]);
+				    }
+				    stacked.push_back(StackTensorMemory(column));
+			    }
+		    } catch (...) {
+			    for (TensorMemory* memory : stacked) delete memory;
+			    for (auto& instance_outputs : outputs) {
+				    for (TensorMemory* memory : instance_outputs) delete memory;
+			    }
+			    throw;
+		    }
+		    for (auto& instance_outputs : outputs) {
+			    for (TensorMemory* memory : instance_outputs) delete memory;
+		    }
+		    return py::object(OutputsToTuple(stacked));
+	    },
+	    py::arg("inputs"), py::arg("stack") = true,
+	    "Evaluate the TensorProgram for each tuple of inputs in the list, "
+	    "running the instances in parallel when their kernels are too small to "
+	    "use all threads. Returns the outputs stacked along "
+	    "a new leading dimension, or a list of output tuples if stack=False. "
+	    "An empty list of inputs returns an empty tuple, or an empty list if "
+	    "stack=False");
+
+	tensor_program.def(
+	    "run_async",
+	    [](const py::object& self, py::args py_inputs) {
+		    auto& program = self.cast<TensorProgram&>();
 		    vector<TensorMemory*> inputs = TensorMemoryFromTuple(py_inputs);
-		    vector<TensorMemory*> outputs = program.Evaluate(inputs);
-		    // output a tuple of tensor memories
-		    py::tuple py_outputs = py::tuple(outputs.size());
-		    for (size_t i = 0; i < outputs.size(); i++) {
-			    py_outputs[i] = py::cast(*outputs[i]);
+		    auto* future = new ProgramFuture();
+		    future->future = program.EvaluateAsync(inputs);
+		    future->keep_alive = py::make_tuple(self, py_inputs);
+		    return future;
+	    },
+	    "Evaluate the TensorProgram on a background thread, returns a "
+	    "ProgramFuture");
+
+	program_future.def("result", &ProgramFuture::Result,
+	                   "Wait for the program to finish and return its outputs");
+	program_future.def("wait", &ProgramFuture::Wait,
+	                   "Wait for the program to finish");
+	program_future.def("done", &ProgramFuture::Done,
+	                   "Check if the program has finished");
+
+	tensor_program.def(
+	    "profile",
+	    [](TensorProgram& program) {
+		    ProgramProfile& profile = program.plan->profile;
+		    std::lock_guard<std::mutex> lock(profile.mutex);
+		    py::list table;
+		    for (size_t i = 0; i < program.plan->steps.size(); i++) {
+			    const PlanStep& step = program.plan->steps[i];
+			    const KernelProfile& kernel = profile.steps[i];
+			    if (step.type != KernelType::Compute) {
+				    continue;
+			    }
+			    py::dict row;
+			    row["kernel"] = step.kernel->kernel_name_;
+			    row["calls"] = kernel.calls;
+			    row["total_ms"] = kernel.total_time;
+			    row["mean_ms"] = kernel.GetMeanTime();
+			    row["min_ms"] = kernel.min_time;
+			    row["max_ms"] = kernel.max_time;
+			    row["p99_ms"] = kernel.GetPercentile(99.0);
+			    row["threads"] = kernel.threads;
+			    row["bytes"] = kernel.bytes;
+			    row["cost"] = step.cost;
+			    AddCounterStatistics(row, kernel.counters);
+			    row["source"] = step.kernel->generated_code_;
+			    table.append(row);
 		    }
-		    return py_outputs;
+		    return table;
 	    },
-	    "Evaluate the TensorProgram with the given inputs");
+	    "Per kernel launch statistics collected while tf.profiling() is "
+	    "enabled, one dict per kernel in program order");
+
+	tensor_program.def(
+	    "reset_profile",
+	    [](TensorProgram& program) { program.plan->profile.Reset(); },
+	    "Clear the collected kernel statistics");
 
 	tensor_program.def(
 	    "list_operations",
@@ -18,7 +18,8 @@ PYBIND11_MODULE(TensorFrost, m) {
 	auto py_tensor = py::class_<PyTensor>(m, "Tensor");
 	auto tensor_view = py::class_<TensorView>(m, "TensorView");
 	auto tensor_program = py::class_<TensorProgram>(m, "TensorProgram");
-	auto py_tensor_mem = py::class_<TensorMemory>(m, "TensorMemory");
+	auto py_tensor_mem =
+	    py::class_<TensorMemory>(m, "TensorMemory", py::buffer_protocol());
 
 	data_type.value("float", DataType::Float);
 	data_type.value("int", DataType::Int);
@@ -48,10 +49,63 @@ PYBIND11_MODULE(TensorFrost, m) {
 	TensorProgramDefinition(m, tensor_program);
 	TensorMemoryDefinition(m, py_tensor_mem);
 
-	m.def("initialize",
-	      [](BackendType backend_type, const std::string& kernel_compile_options) {
-		      InitializeBackend(backend_type, kernel_compile_options);
-	      });
+	m.def(
+	    "initialize",
+	    [](BackendType backend_type, const std::string& kernel_compile_options,
+	       const std::string& kernel_compiler, bool jit, int thread_count,
+	       uint chunk_size, bool thread_affinity, bool concurrent_kernels,
+	       bool vectorize, bool tiling, const std::vector<uint>& tile_size,
+	       bool autotune, bool specialize, bool interior_split) {
+		    kernel_jit_enabled = jit;
+		    kernel_concurrency = concurrent_kernels;
+		    kernel_vectorization = vectorize;
+		    kernel_tiling = tiling;
+		    kernel_interior_split = interior_split;
+		    kernel_tile_size = tile_size;
+		    kernel_autotuning = autotune;
+		    kernel_specialization = specialize;
+		    cpu_thread_count = thread_count;
+		    cpu_chunk_size = chunk_size;
+		    cpu_thread_affinity = thread_affinity;
+		    InitializeBackend(backend_type, kernel_compile_options, kernel_compiler);
+	    },
+	    py::arg("backend_type"), py::arg("kernel_compile_options") = "",
+	    py::arg("kernel_compiler") = "", py::arg("jit") = false,
+	    py::arg("thread_count") = 0, py::arg("chunk_size") = 0,
+	    py::arg("thread_affinity") = false, py::arg("concurrent_kernels") = true,
+	    py::arg("vectorize") = true, py::arg("tiling") = true,
+	    py::arg("tile_size") = std::vector<uint>{64, 16},
+	    py::arg("autotune") = false, py::arg("specialize") = false,
+	    py::arg("interior_split") = true);
+
+	m.def(
+	    "kernel_cache",
+	    [](bool enabled, const std::string& path, uint64_t max_size_mb) {
+		    kernel_cache_enabled = enabled;
+		    kernel_cache_path = path;
+		    kernel_cache_max_size = max_size_mb * 1024 * 1024;
+	    },
+	    py::arg("enabled") = true, py::arg("path") = "",
+	    py::arg("max_size_mb") = 512,
+	    "Configure the on-disk cache of compiled kernel libraries");
+
+	m.def(
+	    "profiling",
+	    [](bool enabled, bool hardware_counters) {
+		    kernel_profiling = enabled;
+		    kernel_hardware_counters = hardware_counters;
+	    },
+	    py::arg("enabled") = true, py::arg("hardware_counters") = false,
+	    "Time every kernel launch, read the results with program.profile(). "
+	    "With hardware_counters the CPU performance counters are read too "
+	    "(Linux only)");
+
+	m.def("start_trace", &StartTrace,
+	      "Start recording a timeline of compilation and kernel execution");
+	m.def("stop_trace", &StopTrace, "Stop recording the timeline");
+	m.def("save_trace", &SaveTrace, py::arg("path"),
+	      "Save the recorded timeline as a Chrome trace JSON file, viewable in "
+	      "Perfetto. Returns the number of events");
 
 	py::print("TensorFrost module loaded!");
 }
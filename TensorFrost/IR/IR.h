@@ -357,16 +357,31 @@ class IR {
 	                                 Lable* cluster_head, int dims,
 	                                 Tensors kernel_shape);
 
+	bool HasIndexedLoads(Lable* cluster);
+
 	void TransformToLinearIndex();
 
 	~IR();
 
-	//TODO (Moroz): Make this per kernel
+	// MultiDimensionalBlocks is used for the kernels that benefit from tiles,
+	// the others run as MultiDimensional
 	void SetKernelIndexingMode(KernelIndexingMode indexing_mode)
 	{
 		indexing_mode_ = indexing_mode; 
 	}
 
+	// indexing mode chosen for the cluster by TransformToLinearIndex
+	KernelIndexingMode GetClusterIndexingMode(Lable* cluster) const {
+		auto mode = cluster_indexing_modes_.find(cluster);
+		if (mode == cluster_indexing_modes_.end()) {
+			// not transformed, nothing to tile
+			return indexing_mode_ == KernelIndexingMode::MultiDimensionalBlocks
+			           ? KernelIndexingMode::MultiDimensional
+			           : indexing_mode_;
+		}
+		return mode->second;
+	}
+
 	//TODO (Moroz): Make this per tensor
 	void SetTensorIndexingMode(TensorIndexingMode indexing_mode)
 	{
@@ -376,6 +391,7 @@ class IR {
 	vector<Node*> nodes_;
 	KernelIndexingMode indexing_mode_ = KernelIndexingMode::Linear;
 	TensorIndexingMode tensor_indexing_mode_ = TensorIndexingMode::Unsafe;
+	map<Lable*, KernelIndexingMode> cluster_indexing_modes_;
  private:
 	vector<Node*> cluster_nodes_;
 	Iterator cursor_ = Iterator(nullptr);
@@ -592,6 +592,17 @@ void IR::MultiDimensionalModeIndices(Tensor*& thread_index, vector<Tensor*>& ind
 	}
 }
 
+bool IR::HasIndexedLoads(Lable* cluster) {
+	for (auto node = Iterator(cluster->node_); !node.is_cluster_end(cluster);
+	     ++node) {
+		if (node->op->GetOpType() == OpType::Load &&
+		    !node->GetArguments(Arg::Type::Index).empty()) {
+			return true;
+		}
+	}
+	return false;
+}
+
 void IR::TransformToLinearIndex() {
 	ClusterProp clusters = GetClusterProperties();
 
@@ -618,13 +629,24 @@ void IR::TransformToLinearIndex() {
 		Tensor* thread_index;
 		vector<Tensor*> indices = vector<Tensor*>(dims);
 
-		switch (indexing_mode_)
+		// tiles only pay off when items read their neighbours' data (stencils,
+		// gathers), kernels that read every element once stream whole rows
+		KernelIndexingMode mode = indexing_mode_;
+		if (mode == KernelIndexingMode::MultiDimensionalBlocks &&
+		    (dims < 2 || !HasIndexedLoads(cluster_begin))) {
+			mode = KernelIndexingMode::MultiDimensional;
+		}
+		cluster_indexing_modes_[cluster_begin] = mode;
+
+		switch (mode)
 		{ 
 		case KernelIndexingMode::Linear:
 			LinearModeIndices(thread_index, indices, cluster_begin, dims, kernel_shape);
 			break;
 		case KernelIndexingMode::MultiDimensional:
-		case KernelIndexingMode::MultiDimensionalBlocks: //TODO (Moroz): add proper support for blocks
+		case KernelIndexingMode::MultiDimensionalBlocks:
+			// blocks only change the order of the items, each dimension still
+			// has its own index
 			MultiDimensionalModeIndices(thread_index, indices, cluster_begin, dims, kernel_shape);
 			break;
 		default:
@@ -755,11 +777,66 @@ Program* GenerateProgram(IR* ir) {
 		}
 
 		// add the cluster to the program
-		program->AddKernel(type, ir->indexing_mode_, begin, variables, memory_nodes,
-		                   shape, dim);
+		program->AddKernel(type, ir->GetClusterIndexingMode(begin->cluster_head_),
+		                   begin, variables, memory_nodes, shape, dim);
 	}
 
 	return program;
 }
 
+bool IsIntConstant(const Node* node, int value) {
+	return node->name == "const" && node->GetTensor()->type == DataType::Int &&
+	       AsInt(node->GetTensor()->data[0]) == value;
+}
+
+vector<IndexClamp> FindIndexClamps(const Kernel* kernel) {
+	vector<IndexClamp> clamps;
+	Lable* cluster = kernel->begin_->cluster_head_;
+	for (auto node = IR::Iterator(cluster->node_); !node.is_cluster_end(cluster);
+	     ++node) {
+		if (node->name != "clamp" || node->GetTensor()->type != DataType::Int) {
+			continue;
+		}
+
+		// clamp(index, 0, size - 1), as generated by ComputeFlatIndex
+		ArgMap arg_map = node->GetArgumentMap(Arg::Type::Input);
+		if (arg_map.size() != 3) continue;
+		Node* index = arg_map[0]->from_->get();
+		Node* high = arg_map[2]->from_->get();
+		if (!IsIntConstant(arg_map[1]->from_->get(), 0) || high->name != "sub") {
+			continue;
+		}
+		ArgMap high_args = high->GetArgumentMap(Arg::Type::Input);
+		Node* size = high_args[0]->from_->get();
+		if (!IsIntConstant(high_args[1]->from_->get(), 1)) continue;
+		bool is_variable = size->name == "memory" && kernel->variables.contains(size);
+		bool is_constant =
+		    size->name == "const" && size->GetTensor()->type == DataType::Int;
+		if (!is_variable && !is_constant) continue;
+
+		// index is dim, dim + offset, offset + dim or dim - offset
+		int offset = 0;
+		if (index->name == "add" || index->name == "sub") {
+			ArgMap index_args = index->GetArgumentMap(Arg::Type::Input);
+			Node* a = index_args[0]->from_->get();
+			Node* b = index_args[1]->from_->get();
+			if (index->name == "add" && a->name == "const") {
+				std::swap(a, b);
+			}
+			if (b->name != "const" || b->GetTensor()->type != DataType::Int) {
+				continue;
+			}
+			offset = AsInt(b->GetTensor()->data[0]);
+			if (index->name == "sub") offset = -offset;
+			index = a;
+		}
+		if (index->name != "dim_id") continue;
+		int dim = (int)index->GetTensor()->data[0];
+		if (dim >= kernel->dim) continue;
+
+		clamps.push_back({node.get(), dim, offset, size});
+	}
+	return clamps;
+}
+
 }  // namespace TensorFrost
\ No newline at end of file
@@ -10,6 +10,11 @@ namespace TensorFrost {
 bool IsBoundary(const Node* input, const Node* output, int arg_index,
                 Arg::Type arg_type);
 
+// arguments: memory manager, variables, memory offsets, shape, and the work
+// items [begin, end) to run on the calling thread
+using KernelRangeCallback =
+    function<void(TensorMemoryManager*, uint*, uint*, uint*, uint, uint)>;
+
 enum KernelType {
 	Memory,
 	Compute,
@@ -24,10 +29,24 @@ class Kernel {
 	map<Node*, int> memory;
 	ArgMap shape;
 	int dim = 0;
-	function<void(TensorMemoryManager*, vector<uint>, vector<uint>, vector<uint>)>
-	    execute_callback;
+	// MultiDimensionalBlocks: tile size of each dimension, passed to the
+	// kernel after the shape so it can be changed without recompiling
+	vector<uint> tile_size;
+	// thread pool chunks per thread, 0 leaves the chunk size to the pool
+	uint chunks_per_thread = 0;
+	// arguments: memory manager, variables, memory offsets, shape
+	function<void(TensorMemoryManager*, uint*, uint*, uint*)> execute_callback;
+	// same, but only runs the work items [begin, end) on the calling thread
+	KernelRangeCallback execute_range_callback;
 
 	string generated_code_;
+	string kernel_name_;
+	// complete function definition, compiled on its own after the prelude
+	string generated_function_;
+	// body function shared by the generic and the shape specialized entry
+	// points, and the buffer arguments the entry points pass to it
+	string generated_body_;
+	string generated_buffer_arguments_;
 };
 
 class Program {
@@ -36,6 +55,8 @@ class Program {
 	vector<Kernel> kernels_;
 	function<void()> unload_callback;
 	string generated_code_;
+	// kernels have to run on one thread (compiled without atomics)
+	bool single_threaded = false;
 
 	explicit Program(IR* ir) : ir_(ir) {}
 
@@ -48,8 +69,30 @@ class Program {
 		kernels_.push_back(
 		    {type, indexing_mode, begin, std::move(variables), std::move(memory), std::move(shape), dim});
 	}
+
+	~Program() {
+		if (unload_callback) {
+			unload_callback();
+		}
+	}
 };
 
 Program* GenerateProgram(IR* ir);
 
+// an index of a load or store clamped to [0, size - 1] that is a kernel index
+// plus a constant offset, the clamp does nothing where
+// 0 <= dim + offset < size
+class IndexClamp {
+ public:
+	Node* node;
+	int dim;
+	int offset;
+	// a kernel variable or a constant
+	Node* size;
+};
+
+// the clamps of a compute kernel that can be dropped in the interior of its
+// iteration space
+vector<IndexClamp> FindIndexClamps(const Kernel* kernel);
+
 }  // namespace TensorFrost
\ No newline at end of file
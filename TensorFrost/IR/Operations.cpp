@@ -1,4 +1,5 @@
 #include "Operations.h"
+#include <algorithm>
 #include <iostream>
 
 namespace TensorFrost {
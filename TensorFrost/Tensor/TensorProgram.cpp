@@ -5,11 +5,16 @@
 namespace TensorFrost {
 
 void TensorProgram::CreateProgram() {
+	TraceScope trace("compile", "CreateProgram");
 	Tensor::SetEvaluationContext(nullptr);
 
 	// create new IR graph
 	Tensor::SetEvaluationContext(&ir);
-	Tensors outputs = evaluate_callback();
+	Tensors outputs;
+	{
+		TraceScope trace_pass("compile", "Evaluate");
+		outputs = evaluate_callback();
+	}
 	// set outputs
 	for (int i = 0; i < outputs.size(); i++) {
 		outputs[i]->SetMemoryType(MemoryType::Output, i);
@@ -18,25 +23,60 @@ void TensorProgram::CreateProgram() {
 	//TODO (Moroz): Make sure that shape works with non-const tensors
 	//TODO (Moroz): Add auto tests into build system
 
-	ir.SetKernelIndexingMode(KernelIndexingMode::MultiDimensional);
+	ir.SetKernelIndexingMode(kernel_tiling
+	                             ? KernelIndexingMode::MultiDimensionalBlocks
+	                             : KernelIndexingMode::MultiDimensional);
 	ir.SetTensorIndexingMode(TensorIndexingMode::Clamp);
-	ir.Clusterize();
-	ir.OptimizeClusters();
-	ir.RemoveUnusedNodes();
-	ir.PostProcessClusters();
-	ir.TransformToLinearIndex();
+	{
+		TraceScope trace_pass("compile", "Clusterize");
+		ir.Clusterize();
+	}
+	{
+		TraceScope trace_pass("compile", "OptimizeClusters");
+		ir.OptimizeClusters();
+	}
+	{
+		TraceScope trace_pass("compile", "RemoveUnusedNodes");
+		ir.RemoveUnusedNodes();
+	}
+	{
+		TraceScope trace_pass("compile", "PostProcessClusters");
+		ir.PostProcessClusters();
+	}
+	{
+		TraceScope trace_pass("compile", "TransformToLinearIndex");
+		ir.TransformToLinearIndex();
+	}
 	//ir.RemoveUnusedNodes();
 
-	program = GenerateProgram(&ir);
+	{
+		TraceScope trace_pass("compile", "GenerateProgram");
+		program = GenerateProgram(&ir);
+	}
 
 	Tensor::SetEvaluationContext(nullptr);
 
 	CompileAndLoadKernel(program);
+
+	TraceScope trace_pass("compile", "GenerateExecutionPlan");
+	plan = GenerateExecutionPlan(program);
 }
 
 vector<TensorMemory*> TensorProgram::Evaluate(
     const vector<TensorMemory*>& input) const {
-	return ExecuteProgram(program, input);
+	return ExecuteProgram(plan, input);
+}
+
+vector<vector<TensorMemory*>> TensorProgram::EvaluateBatch(
+    const vector<vector<TensorMemory*>>& inputs) const {
+	return ExecuteProgramBatch(plan, inputs);
+}
+
+std::shared_future<vector<TensorMemory*>> TensorProgram::EvaluateAsync(
+    const vector<TensorMemory*>& input) const {
+	ExecutionPlan* execution_plan = plan;
+	return GetExecutionQueue().Submit(
+	    [execution_plan, input]() { return ExecuteProgram(execution_plan, input); });
 }
 
 string TensorProgram::PrintProperties() const { 
@@ -59,6 +99,10 @@ string TensorProgram::PrintProperties() const {
 	}
 	properties += "  Kernel count: " + to_string(compute_kernels) + "\n";
 	properties += "  Intermediate buffers: " + to_string(intermediate_buffers) + "\n";
+	properties += "  Kernel levels: " +
+	              to_string(max(0, (int)plan->level_begin.size() - 1)) + "\n";
+	properties += "  Arena buffer groups: " + to_string(plan->arena_group_count) +
+	              " for " + to_string(plan->arena_buffers.size()) + " buffers\n";
 	properties += "  Lines of generated code: " + to_string(lines) + "\n";
 	properties += "  IR size: " + to_string(ir.nodes_.size()) + "\n";
 	return properties;
@@ -20,6 +20,7 @@ class TensorProgram {
 	EvaluateFunction evaluate_callback;
 	IR ir;
 	Program* program;
+	ExecutionPlan* plan;
 	bool debug = false;
 
 	explicit TensorProgram(EvaluateFunction evaluate)
@@ -32,9 +33,21 @@ class TensorProgram {
 	[[nodiscard]] vector<TensorMemory*> Evaluate(
 	    const vector<TensorMemory*>& input) const;
 
+	// runs the program over many independent input sets in one call
+	[[nodiscard]] vector<vector<TensorMemory*>> EvaluateBatch(
+	    const vector<vector<TensorMemory*>>& inputs) const;
+
+	// runs on the background execution queue, the inputs and the program must
+	// stay alive until the future is ready
+	[[nodiscard]] std::shared_future<vector<TensorMemory*>> EvaluateAsync(
+	    const vector<TensorMemory*>& input) const;
+
 	string PrintProperties() const;
 
-	~TensorProgram() { delete program; }
+	~TensorProgram() {
+		delete plan;
+		delete program;
+	}
 };
 
 }  // namespace TensorFrost
\ No newline at end of file
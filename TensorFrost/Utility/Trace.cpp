@@ -0,0 +1,198 @@
+#include "Trace.h"
+
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace TensorFrost {
+
+std::atomic<bool> trace_enabled = false;
+
+struct TraceEvent {
+	char name[kTraceNameSize];
+	const char* category;
+	uint64_t start;
+	uint64_t end;
+};
+
+constexpr size_t kTraceChunkCount = kTraceBufferSize / kTraceChunkSize;
+
+// written only by its own thread, read when the trace is saved. Chunks are
+// allocated on first use and published before the count that covers them
+class TraceBuffer {
+ public:
+	std::atomic<TraceEvent*> chunks[kTraceChunkCount] = {};
+	std::atomic<size_t> count = 0;
+	// trace session the events belong to
+	std::atomic<uint64_t> session = 0;
+	// set when the thread exits, its buffer is freed once a newer session
+	// makes its events unreachable
+	std::atomic<bool> exited = false;
+	int thread_index = 0;
+
+	~TraceBuffer() {
+		for (auto& chunk : chunks) {
+			delete[] chunk.load(std::memory_order_relaxed);
+		}
+	}
+
+	TraceEvent& GetEvent(size_t index) const {
+		return chunks[index / kTraceChunkSize].load(
+		    std::memory_order_relaxed)[index % kTraceChunkSize];
+	}
+};
+
+// incremented by StartTrace, buffers of older sessions are reset on their
+// next write and skipped when saving
+std::atomic<uint64_t> trace_session = 1;
+
+// buffers are kept after their thread exits so its events can be saved, until
+// a newer session starts
+std::mutex trace_buffers_mutex;
+vector<shared_ptr<TraceBuffer>> trace_buffers;
+int trace_thread_count = 0;
+
+// frees the buffers of exited threads that hold no events of the session,
+// trace_buffers_mutex must be locked
+void RemoveExitedTraceBuffers(uint64_t session) {
+	std::erase_if(trace_buffers, [&](const shared_ptr<TraceBuffer>& buffer) {
+		return buffer->exited.load(std::memory_order_acquire) &&
+		       buffer->session.load(std::memory_order_relaxed) != session;
+	});
+}
+
+// marks the buffer when its thread exits
+class ThreadTraceBuffer {
+ public:
+	shared_ptr<TraceBuffer> buffer;
+
+	~ThreadTraceBuffer() {
+		if (buffer) {
+			buffer->exited.store(true, std::memory_order_release);
+		}
+	}
+};
+
+TraceBuffer& GetThreadTraceBuffer() {
+	thread_local ThreadTraceBuffer thread_buffer;
+	shared_ptr<TraceBuffer>& buffer = thread_buffer.buffer;
+	if (!buffer) {
+		buffer = make_shared<TraceBuffer>();
+		std::lock_guard<std::mutex> lock(trace_buffers_mutex);
+		RemoveExitedTraceBuffers(trace_session.load(std::memory_order_acquire));
+		buffer->thread_index = trace_thread_count++;
+		trace_buffers.push_back(buffer);
+	}
+	return *buffer;
+}
+
+uint64_t GetTraceTime() {
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+	           std::chrono::steady_clock::now().time_since_epoch())
+	    .count();
+}
+
+void StartTrace() {
+	uint64_t session = trace_session.fetch_add(1, std::memory_order_acq_rel) + 1;
+	{
+		std::lock_guard<std::mutex> lock(trace_buffers_mutex);
+		RemoveExitedTraceBuffers(session);
+	}
+	trace_enabled = true;
+}
+
+void StopTrace() { trace_enabled = false; }
+
+void RecordTraceEvent(const char* category, const char* name, uint64_t start,
+                      uint64_t end) {
+	TraceBuffer& buffer = GetThreadTraceBuffer();
+	uint64_t session = trace_session.load(std::memory_order_acquire);
+	size_t index = buffer.count.load(std::memory_order_relaxed);
+	if (buffer.session.load(std::memory_order_relaxed) != session) {
+		buffer.session.store(session, std::memory_order_relaxed);
+		index = 0;
+	}
+	if (index >= kTraceBufferSize) {
+		buffer.count.store(index, std::memory_order_release);
+		return;
+	}
+
+	auto& chunk = buffer.chunks[index / kTraceChunkSize];
+	if (chunk.load(std::memory_order_relaxed) == nullptr) {
+		chunk.store(new TraceEvent[kTraceChunkSize], std::memory_order_relaxed);
+	}
+	TraceEvent& event = buffer.GetEvent(index);
+	strncpy(event.name, name, kTraceNameSize - 1);
+	event.name[kTraceNameSize - 1] = '\0';
+	event.category = category;
+	event.start = start;
+	event.end = end;
+	buffer.count.store(index + 1, std::memory_order_release);
+}
+
+void WriteJsonString(std::ofstream& file, const char* text) {
+	file << '"';
+	for (const char* c = text; *c != '\0'; c++) {
+		if (*c == '"' || *c == '\\') {
+			file << '\\' << *c;
+		} else if ((unsigned char)*c >= 0x20) {
+			file << *c;
+		}
+	}
+	file << '"';
+}
+
+size_t SaveTrace(const string& path) {
+	std::ofstream file(path);
+	if (!file) {
+		throw std::runtime_error("Cannot open trace file " + path);
+	}
+
+	vector<shared_ptr<TraceBuffer>> buffers;
+	{
+		std::lock_guard<std::mutex> lock(trace_buffers_mutex);
+		buffers = trace_buffers;
+	}
+	uint64_t session = trace_session.load(std::memory_order_acquire);
+
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	file.precision(3);
+	file << std::fixed;
+	size_t written = 0;
+	for (const auto& buffer : buffers) {
+		if (buffer->session.load(std::memory_order_relaxed) != session) {
+			continue;
+		}
+		size_t count = buffer->count.load(std::memory_order_acquire);
+		count = std::min(count, kTraceBufferSize);
+		if (count == 0) {
+			continue;
+		}
+
+		file << (written == 0 ? "" : ",")
+		     << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+		     << buffer->thread_index << ",\"args\":{\"name\":\"thread "
+		     << buffer->thread_index << "\"}}";
+		for (size_t i = 0; i < count; i++) {
+			const TraceEvent& event = buffer->GetEvent(i);
+			file << ",\n{\"name\":";
+			WriteJsonString(file, event.name);
+			file << ",\"cat\":";
+			WriteJsonString(file, event.category);
+			file << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->thread_index
+			     << ",\"ts\":" << (double)event.start / 1000.0
+			     << ",\"dur\":" << (double)(event.end - event.start) / 1000.0
+			     << "}";
+		}
+		written += count;
+	}
+	file << "\n]}\n";
+	return written;
+}
+
+}  // namespace TensorFrost
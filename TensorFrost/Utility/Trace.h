@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace TensorFrost {
+
+using namespace std;
+
+// Timeline of compilation and execution, saved in the Chrome trace event
+// format (chrome://tracing, ui.perfetto.dev). Every thread records into its
+// own buffer without locking, the buffer grows in chunks up to a fixed size
+// and events past its end are dropped. Timestamps are steady clock
+// microseconds, the same clock as time.perf_counter() on most platforms, so
+// the trace can be aligned with other traces of the application.
+
+extern std::atomic<bool> trace_enabled;
+
+// events each thread can record between StartTrace calls
+constexpr size_t kTraceBufferSize = 1 << 16;
+// events allocated at a time
+constexpr size_t kTraceChunkSize = 1 << 10;
+// longer event names are cut
+constexpr size_t kTraceNameSize = 48;
+
+uint64_t GetTraceTime();
+
+// clears the previously recorded events and starts recording
+void StartTrace();
+void StopTrace();
+// writes the recorded events as JSON, returns the number of events
+size_t SaveTrace(const string& path);
+
+void RecordTraceEvent(const char* category, const char* name, uint64_t start,
+                      uint64_t end);
+
+// records the time between its construction and destruction
+class TraceScope {
+ public:
+	TraceScope(const char* category, const char* name)
+	    : category_(category), name_(name) {
+		if (trace_enabled.load(std::memory_order_relaxed)) {
+			start_ = GetTraceTime();
+		}
+	}
+
+	TraceScope(const char* category, const string& name)
+	    : TraceScope(category, name.c_str()) {}
+
+	TraceScope(const TraceScope&) = delete;
+	TraceScope& operator=(const TraceScope&) = delete;
+
+	~TraceScope() {
+		if (start_ != 0 && trace_enabled.load(std::memory_order_relaxed)) {
+			RecordTraceEvent(category_, name_, start_, GetTraceTime());
+		}
+	}
+
+ private:
+	const char* category_;
+	const char* name_;
+	uint64_t start_ = 0;
+};
+
+}  // namespace TensorFrost
@@ -2,7 +2,9 @@
 
 #include <vector>
 
+#ifdef _WIN32
 #include <intrin.h>
+#endif
 
 namespace TensorFrost {
 using namespace std;
@@ -0,0 +1,350 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Programs.h"
+#include "References.h"
+
+using namespace TensorFrost;
+
+// Measures compile latency and steady state execution time of the example
+// workloads over several problem sizes. The outputs of every size are checked
+// against a scalar reference, a mismatch fails the benchmark.
+//
+//   TensorFrostBenchmark [--filter name] [--quick] [--iterations N]
+//                        [--min-time seconds] [--threads N] [--kernel-cache]
+//                        [--specialize] [--output results.json]
+
+namespace {
+
+struct BenchmarkCase {
+	string name;
+	vector<int> sizes;
+	// builds the program for a size, fixed size programs use it directly
+	function<Tensors(int)> program;
+	// input shapes for a size
+	function<vector<vector<int>>(int)> inputs;
+	// elements processed by one run, used for the throughput
+	function<double(int)> elements;
+	// scalar version of the program for a size and the input data
+	function<ReferenceData(int, const ReferenceData&)> reference;
+	// allowed error relative to the magnitude of the expected value
+	double tolerance = 1e-4;
+	// share of the elements of an output allowed to exceed the tolerance
+	double mismatch_fraction = 0.0;
+};
+
+struct BenchmarkResult {
+	string name;
+	int size = 0;
+	double compile_ms = 0.0;
+	int iterations = 0;
+	double mean_ms = 0.0;
+	double median_ms = 0.0;
+	double min_ms = 0.0;
+	double stddev_ms = 0.0;
+	double elements_per_second = 0.0;
+	// compulsory traffic: every input read and every output written once
+	double gigabytes_per_second = 0.0;
+};
+
+struct BenchmarkOptions {
+	string filter;
+	bool quick = false;
+	int iterations = 20;
+	double min_time = 0.5;
+	int threads = 0;
+	bool kernel_cache = false;
+	bool specialize = false;
+	string output;
+};
+
+vector<BenchmarkCase> GetBenchmarkCases() {
+	auto square = [](int count) {
+		return [count](int n) {
+			return vector<vector<int>>(count, vector<int>{n, n});
+		};
+	};
+	auto cells = [](int n) { return (double)n * n; };
+
+	return {
+	    {"matmul", {128, 256, 512}, [](int) { return MatMulProgram(); },
+	     square(2), [](int n) { return (double)n * n * n; }, MatMulReference,
+	     1e-3},
+	    {"wave", {256, 1024, 2048}, [](int) { return WaveEqProgram(); },
+	     square(2), cells, WaveEqReference},
+	    {"jacobi", {256, 512, 1024}, [](int) { return JacobiProgram(); },
+	     square(2), cells, JacobiReference},
+	    // fused multiply adds can move the escape of an orbit on the edge of
+	    // the set by one iteration, a few pixels in a million at 1024 and 2048
+	    {"mandelbrot", {256, 1024, 2048}, MandelbrotProgram,
+	     [](int) { return vector<vector<int>>(); }, cells, MandelbrotReference,
+	     1e-4, 1e-4},
+	    {"advect_bilinear", {256, 512, 1024},
+	     [](int) { return BilinearAdvectionProgram(); }, square(3), cells,
+	     BilinearAdvectionReference},
+	    {"advect_cubic", {256, 512, 1024},
+	     [](int) { return CubicAdvectionProgram(); }, square(3), cells,
+	     CubicAdvectionReference},
+	    {"row_stencil", {256, 1024, 2048}, [](int) { return RowStencilProgram(); },
+	     square(1), cells, RowStencilReference},
+	};
+}
+
+// deterministic values in [-1, 1]
+TensorMemory* CreateInput(const vector<int>& shape, uint seed) {
+	int size = 1;
+	for (int dim : shape) size *= dim;
+	vector<uint> data(size);
+	uint state = seed * 747796405u + 2891336453u;
+	for (int i = 0; i < size; i++) {
+		state = state * 1664525u + 1013904223u;
+		data[i] = AsUint((float)(state >> 8) / (float)(1u << 23) - 1.0f);
+	}
+	return global_memory_manager->AllocateWithData(shape, data);
+}
+
+vector<float> ReadFloats(TensorMemory* memory) {
+	vector<uint> data = global_memory_manager->Readback(memory);
+	vector<float> values(data.size());
+	for (size_t i = 0; i < data.size(); i++) {
+		values[i] = AsFloat(data[i]);
+	}
+	return values;
+}
+
+// compares the outputs of a run with the scalar reference
+void CheckOutputs(const BenchmarkCase& benchmark, int size,
+                  const vector<TensorMemory*>& inputs,
+                  const vector<TensorMemory*>& outputs) {
+	ReferenceData input_data;
+	for (TensorMemory* input : inputs) {
+		input_data.push_back(ReadFloats(input));
+	}
+	ReferenceData expected = benchmark.reference(size, input_data);
+	if (expected.size() != outputs.size()) {
+		throw std::runtime_error(benchmark.name + " returned " +
+		                         to_string(outputs.size()) + " outputs, expected " +
+		                         to_string(expected.size()));
+	}
+	for (size_t k = 0; k < outputs.size(); k++) {
+		vector<float> values = ReadFloats(outputs[k]);
+		if (values.size() != expected[k].size()) {
+			throw std::runtime_error(benchmark.name + " output " + to_string(k) +
+			                         " has " + to_string(values.size()) +
+			                         " elements, expected " +
+			                         to_string(expected[k].size()));
+		}
+		size_t mismatches = 0;
+		size_t first = 0;
+		for (size_t i = 0; i < values.size(); i++) {
+			double error = std::abs((double)values[i] - expected[k][i]);
+			// also catches NaN
+			if (!(error <= benchmark.tolerance * (1.0 + std::abs(expected[k][i])))) {
+				if (mismatches++ == 0) {
+					first = i;
+				}
+			}
+		}
+		if (mismatches > benchmark.mismatch_fraction * values.size()) {
+			throw std::runtime_error(
+			    benchmark.name + " size " + to_string(size) + " output " +
+			    to_string(k) + " has " + to_string(mismatches) +
+			    " wrong elements, element " + to_string(first) + " is " +
+			    to_string(values[first]) + ", expected " +
+			    to_string(expected[k][first]));
+		}
+	}
+}
+
+double GetElapsedMs(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(
+	           std::chrono::steady_clock::now() - start)
+	    .count();
+}
+
+BenchmarkResult RunBenchmark(const BenchmarkCase& benchmark, int size,
+                             const BenchmarkOptions& options) {
+	BenchmarkResult result;
+	result.name = benchmark.name;
+	result.size = size;
+
+	auto compile_start = std::chrono::steady_clock::now();
+	TensorProgram program([&]() { return benchmark.program(size); });
+	result.compile_ms = GetElapsedMs(compile_start);
+
+	vector<TensorMemory*> inputs;
+	size_t input_size = 0;
+	for (const auto& shape : benchmark.inputs(size)) {
+		inputs.push_back(CreateInput(shape, (uint)inputs.size() + 1));
+		input_size += inputs.back()->GetSize();
+	}
+
+	auto run = [&](bool check) {
+		vector<TensorMemory*> outputs = program.Evaluate(inputs);
+		if (check) {
+			CheckOutputs(benchmark, size, inputs, outputs);
+		}
+		size_t output_size = 0;
+		for (TensorMemory* output : outputs) {
+			output_size += output->GetSize();
+			delete output;
+		}
+		return output_size;
+	};
+
+	// warm up the caches, the arena and the thread pool. The second run uses
+	// the same kernels as the timed ones and checks them
+	size_t output_size = run(false);
+	if (options.specialize) {
+		WaitForShapeVariants(program.plan);
+	}
+	run(true);
+
+	vector<double> times;
+	auto total_start = std::chrono::steady_clock::now();
+	while ((int)times.size() < options.iterations ||
+	       GetElapsedMs(total_start) < options.min_time * 1000.0) {
+		auto start = std::chrono::steady_clock::now();
+		run(false);
+		times.push_back(GetElapsedMs(start));
+	}
+
+	for (TensorMemory* input : inputs) {
+		delete input;
+	}
+
+	std::sort(times.begin(), times.end());
+	result.iterations = (int)times.size();
+	result.min_ms = times.front();
+	result.median_ms = times[times.size() / 2];
+	result.mean_ms =
+	    std::accumulate(times.begin(), times.end(), 0.0) / (double)times.size();
+	double variance = 0.0;
+	for (double time : times) {
+		variance += (time - result.mean_ms) * (time - result.mean_ms);
+	}
+	result.stddev_ms = std::sqrt(variance / (double)times.size());
+
+	double seconds = result.median_ms / 1000.0;
+	double bytes = (double)(input_size + output_size) * sizeof(uint);
+	result.elements_per_second = benchmark.elements(size) / seconds;
+	result.gigabytes_per_second = bytes / seconds / 1e9;
+	return result;
+}
+
+void WriteJson(const string& path, const vector<BenchmarkResult>& results,
+               const BenchmarkOptions& options) {
+	std::ofstream file(path);
+	if (!file) {
+		throw std::runtime_error("Cannot open " + path);
+	}
+	file << "{\n  \"format_version\": 1,\n";
+	file << "  \"threads\": " << GetThreadPool()->GetThreadCount() << ",\n";
+	file << "  \"kernel_cache\": " << (options.kernel_cache ? "true" : "false")
+	     << ",\n";
+	file << "  \"specialize\": " << (options.specialize ? "true" : "false")
+	     << ",\n";
+	file << "  \"compile_options\": \"" << kernel_compile_options << "\",\n";
+	file << "  \"results\": [";
+	for (size_t i = 0; i < results.size(); i++) {
+		const BenchmarkResult& r = results[i];
+		file << (i == 0 ? "\n" : ",\n");
+		file << "    {\"name\": \"" << r.name << "\", \"size\": " << r.size
+		     << ", \"compile_ms\": " << r.compile_ms
+		     << ", \"iterations\": " << r.iterations
+		     << ", \"mean_ms\": " << r.mean_ms
+		     << ", \"median_ms\": " << r.median_ms
+		     << ", \"min_ms\": " << r.min_ms
+		     << ", \"stddev_ms\": " << r.stddev_ms
+		     << ", \"elements_per_second\": " << r.elements_per_second
+		     << ", \"gigabytes_per_second\": " << r.gigabytes_per_second << "}";
+	}
+	file << "\n  ]\n}\n";
+}
+
+BenchmarkOptions ParseOptions(int argc, char** argv) {
+	BenchmarkOptions options;
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		auto value = [&]() -> string {
+			if (i + 1 >= argc) {
+				throw std::runtime_error("Missing value for " + arg);
+			}
+			return argv[++i];
+		};
+		if (arg == "--filter") {
+			options.filter = value();
+		} else if (arg == "--quick") {
+			options.quick = true;
+		} else if (arg == "--iterations") {
+			options.iterations = std::stoi(value());
+		} else if (arg == "--min-time") {
+			options.min_time = std::stod(value());
+		} else if (arg == "--threads") {
+			options.threads = std::stoi(value());
+		} else if (arg == "--kernel-cache") {
+			options.kernel_cache = true;
+		} else if (arg == "--specialize") {
+			options.specialize = true;
+		} else if (arg == "--output") {
+			options.output = value();
+		} else {
+			throw std::runtime_error("Unknown argument " + arg);
+		}
+	}
+	return options;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+	try {
+		BenchmarkOptions options = ParseOptions(argc, argv);
+
+		// measure the real compile latency unless asked otherwise
+		kernel_cache_enabled = options.kernel_cache;
+		kernel_specialization = options.specialize;
+		cpu_thread_count = options.threads;
+		InitializeBackend(BackendType::CPU);
+
+		vector<BenchmarkResult> results;
+		for (const BenchmarkCase& benchmark : GetBenchmarkCases()) {
+			if (!options.filter.empty() &&
+			    benchmark.name.find(options.filter) == string::npos) {
+				continue;
+			}
+			for (int size : benchmark.sizes) {
+				results.push_back(RunBenchmark(benchmark, size, options));
+				if (options.quick) break;
+			}
+		}
+
+		printf("\n%-16s %6s %12s %12s %12s %12s %14s %10s\n", "benchmark", "size",
+		       "compile ms", "median ms", "min ms", "stddev ms", "elements/s",
+		       "GB/s");
+		for (const BenchmarkResult& r : results) {
+			printf("%-16s %6d %12.2f %12.4f %12.4f %12.4f %14.4g %10.3f\n",
+			       r.name.c_str(), r.size, r.compile_ms, r.median_ms, r.min_ms,
+			       r.stddev_ms, r.elements_per_second, r.gigabytes_per_second);
+		}
+
+		if (!options.output.empty()) {
+			WriteJson(options.output, results, options);
+			printf("\nResults written to %s\n", options.output.c_str());
+		}
+	} catch (const std::exception& e) {
+		std::cerr << "Benchmark failed: " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
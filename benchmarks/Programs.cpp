@@ -0,0 +1,180 @@
+#include "Programs.h"
+
+#include <numbers>
+
+namespace TensorFrost {
+
+namespace {
+
+Tensor& F(float value) { return Tensor::Constant(value); }
+Tensor& I(int value) { return Tensor::Constant(value); }
+
+Tensor& At(const Tensor& tensor, const Tensor& i, const Tensor& j) {
+	return Tensor::Load(tensor, {&i, &j});
+}
+
+Tensor& Bilinear(const Tensor& tex, const Tensor& x, const Tensor& y) {
+	Tensor& xi = Tensor::floor(x);
+	Tensor& yi = Tensor::floor(y);
+	Tensor& xf = x - xi;
+	Tensor& yf = y - yi;
+	Tensor& ix = Tensor::toint(xi);
+	Tensor& iy = Tensor::toint(yi);
+	Tensor& oxf = F(1.0f) - xf;
+	Tensor& oyf = F(1.0f) - yf;
+	return At(tex, ix, iy) * oxf * oyf + At(tex, ix + I(1), iy) * xf * oyf +
+	       At(tex, ix, iy + I(1)) * oxf * yf +
+	       At(tex, ix + I(1), iy + I(1)) * xf * yf;
+}
+
+Tensors CubicHermit(const Tensor& x) {
+	Tensor& x2 = x * x;
+	Tensor& x3 = x2 * x;
+	return {&(F(-0.5f) * x3 + x2 - F(0.5f) * x),
+	        &(F(1.5f) * x3 - F(2.5f) * x2 + F(1.0f)),
+	        &(F(-1.5f) * x3 + F(2.0f) * x2 + F(0.5f) * x),
+	        &(F(0.5f) * x3 - F(0.5f) * x2)};
+}
+
+Tensor& CubicInterp(const Tensor& tex, const Tensor& x, const Tensor& y) {
+	Tensor& xi = Tensor::floor(x);
+	Tensor& yi = Tensor::floor(y);
+	Tensors wx = CubicHermit(x - xi);
+	Tensors wy = CubicHermit(y - yi);
+	Tensor& ix = Tensor::toint(xi);
+	Tensor& iy = Tensor::toint(yi);
+
+	Tensor* value_y = &F(0.0f);
+	for (int j = -1; j < 3; j++) {
+		Tensor* value_x = &F(0.0f);
+		for (int i = -1; i < 3; i++) {
+			value_x = &(*value_x + At(tex, ix + I(i), iy + I(j)) * *wx[i + 1]);
+		}
+		value_y = &(*value_y + *value_x * *wy[j + 1]);
+	}
+	return *value_y;
+}
+
+Tensor& Laplacian(const Tensor& p, const Tensor& i, const Tensor& j) {
+	return At(p, i - I(1), j) + At(p, i + I(1), j) + At(p, i, j - I(1)) +
+	       At(p, i, j + I(1));
+}
+
+Tensor& Jacobi(const Tensor& pressure, const Tensor& div, int iterations) {
+	const Tensor* result = &pressure;
+	// every iteration is its own kernel, so it needs its own indices
+	for (int it = 0; it < iterations; it++) {
+		Tensor& i = result->Index(0);
+		Tensor& j = result->Index(1);
+		result = &((Laplacian(*result, i, j) - div) / F(4.0f));
+	}
+	return const_cast<Tensor&>(*result);
+}
+
+Tensor& Residual(const Tensor& pressure, const Tensor& div) {
+	Tensor& i = pressure.Index(0);
+	Tensor& j = pressure.Index(1);
+	return div - (Laplacian(pressure, i, j) - F(4.0f) * pressure);
+}
+
+}  // namespace
+
+Tensors MatMulProgram() {
+	Tensor& A = Tensor::Input({-1, -1});
+	Tensor& B = Tensor::Input({-1, -1});
+
+	Tensors a_shape = A.GetShape();
+	Tensors b_shape = B.GetShape();
+	Tensor& C = Tensor::Constant(Tensors{a_shape[0], b_shape[1]}, 0.0f);
+
+	Tensors shape = {a_shape[0], b_shape[1], a_shape[1]};
+	Tensor& i = Tensor::Index(shape, 0);
+	Tensor& j = Tensor::Index(shape, 1);
+	Tensor& k = Tensor::Index(shape, 2);
+	Tensor::ScatterAdd(C, At(A, i, k) * At(B, k, j), {&i, &j});
+	return {&C};
+}
+
+Tensors WaveEqProgram() {
+	Tensor& u = Tensor::Input({-1, -1});
+	Tensor& v = Tensor::Input({-1, -1});
+	float dt = 0.2f;
+
+	Tensor& i = u.Index(0);
+	Tensor& j = u.Index(1);
+	Tensor& laplacian = Laplacian(u, i, j) - u * F(4.0f);
+	Tensor& force =
+	    laplacian - F(0.1f) * Tensor::sin(F(2.0f * std::numbers::pi_v<float>) * u);
+	Tensor& v_new = v + F(dt) * force;
+	Tensor& u_new = u + F(dt) * v_new;
+	return {&u_new, &v_new};
+}
+
+Tensors JacobiProgram() {
+	Tensor& pressure = Tensor::Input({-1, -1});
+	Tensor& div = Tensor::Input({-1, -1});
+
+	Tensor& result = Jacobi(pressure, div, 16);
+	return {&result, &Residual(result, div)};
+}
+
+Tensors MandelbrotProgram(int S) {
+	Tensor& canvas = Tensor::Constant(vector<int>{S, S, 3}, 0.0f);
+	Tensor& i = Tensor::Index(vector<int>{S, S}, 0);
+	Tensor& j = Tensor::Index(vector<int>{S, S}, 1);
+	Tensor& y = Tensor::tofloat(i);
+	Tensor& x = Tensor::tofloat(j);
+
+	Tensor* z_re = &Tensor::Constant(vector<int>{S, S}, 0.0f);
+	Tensor* z_im = &Tensor::Constant(vector<int>{S, S}, 0.0f);
+	Tensor* count = &Tensor::Constant(vector<int>{S, S}, 0.0f);
+	Tensor& c_re = x * F(2.0f / (float)S) - F(1.5f);
+	Tensor& c_im = y * F(2.0f / (float)S) - F(1.0f);
+
+	// counts the iterations before the orbit escapes, an escaped orbit never
+	// comes back and overflows to inf and then NaN, which compare false
+	for (int k = 0; k < 32; k++) {
+		Tensor& re = *z_re * *z_re - *z_im * *z_im + c_re;
+		Tensor& im = F(2.0f) * *z_re * *z_im + c_im;
+		z_re = &re;
+		z_im = &im;
+		Tensor& inside = (*z_re * *z_re + *z_im * *z_im) < F(4.0f);
+		count = &(*count + Tensor::tofloat(inside));
+	}
+
+	Tensor& t = *count * F(1.0f / 32.0f);
+	Tensor::Store(canvas, t, {&i, &j, &I(0)});
+	Tensor::Store(canvas, t * t, {&i, &j, &I(1)});
+	Tensor::Store(canvas, Tensor::sqrt(t), {&i, &j, &I(2)});
+	return {&canvas};
+}
+
+Tensors BilinearAdvectionProgram() {
+	Tensor& vx = Tensor::Input({-1, -1});
+	Tensor& vy = Tensor::Input({-1, -1});
+	Tensor& density = Tensor::Input({-1, -1});
+
+	Tensor& x = Tensor::tofloat(vx.Index(0)) - vx;
+	Tensor& y = Tensor::tofloat(vx.Index(1)) - vy;
+	return {&Bilinear(density, x, y)};
+}
+
+Tensors CubicAdvectionProgram() {
+	Tensor& vx = Tensor::Input({-1, -1});
+	Tensor& vy = Tensor::Input({-1, -1});
+	Tensor& density = Tensor::Input({-1, -1});
+
+	Tensor& x = Tensor::tofloat(vx.Index(0)) - vx;
+	Tensor& y = Tensor::tofloat(vx.Index(1)) - vy;
+	return {&CubicInterp(density, x, y)};
+}
+
+Tensors RowStencilProgram() {
+	Tensor& A = Tensor::Input({-1, -1});
+
+	Tensor& i = A.Index(0);
+	Tensor& j = A.Index(1);
+	return {&(At(A, i, j + I(1)) + At(A, i, I(0)))};
+}
+
+}  // namespace TensorFrost
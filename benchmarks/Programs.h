@@ -0,0 +1,33 @@
+#pragma once
+
+#include <TensorFrost.h>
+
+namespace TensorFrost {
+
+// The example workloads (examples/*.ipynb) written
+// against the C++ Tensor API. Programs with a fixed size take it as a
+// parameter, the others read it from their input shapes.
+
+// C = A * B through scatter adds, inputs [N, M] and [M, K]
+Tensors MatMulProgram();
+
+// one step of the nonlinear wave equation, inputs u, v [N, M]
+Tensors WaveEqProgram();
+
+// 16 jacobi iterations of the fluid_simulation.ipynb pressure solve and
+// the final residual, inputs pressure, divergence [N, M]
+Tensors JacobiProgram();
+
+// mandelbrot.ipynb, 32 iterations into a [S, S, 3] canvas
+Tensors MandelbrotProgram(int S);
+
+// one semi-lagrangian advection step of the density with bilinear or
+// bicubic interpolation, inputs vx, vy, density [N, M]
+Tensors BilinearAdvectionProgram();
+Tensors CubicAdvectionProgram();
+
+// a clamped stencil load next to a load at the start of the row, which
+// exercises the interior and border row loops together, input [N, M]
+Tensors RowStencilProgram();
+
+}  // namespace TensorFrost
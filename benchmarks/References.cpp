@@ -0,0 +1,191 @@
+#include "References.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+namespace TensorFrost {
+
+namespace {
+
+// square [n, n] tensor with clamped loads
+class Grid {
+ public:
+	int n;
+	const float* data;
+
+	float operator()(int i, int j) const {
+		i = std::clamp(i, 0, n - 1);
+		j = std::clamp(j, 0, n - 1);
+		return data[i * n + j];
+	}
+};
+
+float Laplacian(const Grid& p, int i, int j) {
+	return p(i - 1, j) + p(i + 1, j) + p(i, j - 1) + p(i, j + 1);
+}
+
+void CubicHermit(float x, float w[4]) {
+	float x2 = x * x;
+	float x3 = x2 * x;
+	w[0] = -0.5f * x3 + x2 - 0.5f * x;
+	w[1] = 1.5f * x3 - 2.5f * x2 + 1.0f;
+	w[2] = -1.5f * x3 + 2.0f * x2 + 0.5f * x;
+	w[3] = 0.5f * x3 - 0.5f * x2;
+}
+
+}  // namespace
+
+ReferenceData MatMulReference(int n, const ReferenceData& inputs) {
+	const vector<float>& A = inputs[0];
+	const vector<float>& B = inputs[1];
+	vector<float> C(n * n, 0.0f);
+	for (int i = 0; i < n; i++) {
+		for (int j = 0; j < n; j++) {
+			float sum = 0.0f;
+			for (int k = 0; k < n; k++) {
+				sum += A[i * n + k] * B[k * n + j];
+			}
+			C[i * n + j] = sum;
+		}
+	}
+	return {C};
+}
+
+ReferenceData WaveEqReference(int n, const ReferenceData& inputs) {
+	Grid u = {n, inputs[0].data()};
+	const vector<float>& v = inputs[1];
+	float dt = 0.2f;
+	vector<float> u_new(n * n), v_new(n * n);
+	for (int i = 0; i < n; i++) {
+		for (int j = 0; j < n; j++) {
+			float value = u(i, j);
+			float laplacian = Laplacian(u, i, j) - value * 4.0f;
+			float force = laplacian - 0.1f * std::sin(2.0f * std::numbers::pi_v<float> *
+			                                          value);
+			v_new[i * n + j] = v[i * n + j] + dt * force;
+			u_new[i * n + j] = value + dt * v_new[i * n + j];
+		}
+	}
+	return {u_new, v_new};
+}
+
+ReferenceData JacobiReference(int n, const ReferenceData& inputs) {
+	vector<float> pressure = inputs[0];
+	const vector<float>& div = inputs[1];
+	vector<float> next(n * n);
+	for (int it = 0; it < 16; it++) {
+		Grid p = {n, pressure.data()};
+		for (int i = 0; i < n; i++) {
+			for (int j = 0; j < n; j++) {
+				next[i * n + j] = (Laplacian(p, i, j) - div[i * n + j]) / 4.0f;
+			}
+		}
+		pressure.swap(next);
+	}
+	Grid p = {n, pressure.data()};
+	vector<float> residual(n * n);
+	for (int i = 0; i < n; i++) {
+		for (int j = 0; j < n; j++) {
+			residual[i * n + j] =
+			    div[i * n + j] - (Laplacian(p, i, j) - 4.0f * p(i, j));
+		}
+	}
+	return {pressure, residual};
+}
+
+ReferenceData MandelbrotReference(int S, const ReferenceData&) {
+	vector<float> canvas(S * S * 3);
+	for (int i = 0; i < S; i++) {
+		for (int j = 0; j < S; j++) {
+			float c_re = (float)j * (2.0f / (float)S) - 1.5f;
+			float c_im = (float)i * (2.0f / (float)S) - 1.0f;
+			float z_re = 0.0f;
+			float z_im = 0.0f;
+			float count = 0.0f;
+			for (int k = 0; k < 32; k++) {
+				float re = z_re * z_re - z_im * z_im + c_re;
+				float im = 2.0f * z_re * z_im + c_im;
+				z_re = re;
+				z_im = im;
+				if (z_re * z_re + z_im * z_im < 4.0f) {
+					count += 1.0f;
+				}
+			}
+			float t = count * (1.0f / 32.0f);
+			float* pixel = &canvas[(i * S + j) * 3];
+			pixel[0] = t;
+			pixel[1] = t * t;
+			pixel[2] = std::sqrt(t);
+		}
+	}
+	return {canvas};
+}
+
+ReferenceData BilinearAdvectionReference(int n, const ReferenceData& inputs) {
+	const vector<float>& vx = inputs[0];
+	const vector<float>& vy = inputs[1];
+	Grid tex = {n, inputs[2].data()};
+	vector<float> result(n * n);
+	for (int i = 0; i < n; i++) {
+		for (int j = 0; j < n; j++) {
+			float x = (float)i - vx[i * n + j];
+			float y = (float)j - vy[i * n + j];
+			float xi = std::floor(x);
+			float yi = std::floor(y);
+			float xf = x - xi;
+			float yf = y - yi;
+			int ix = (int)xi;
+			int iy = (int)yi;
+			float oxf = 1.0f - xf;
+			float oyf = 1.0f - yf;
+			result[i * n + j] = tex(ix, iy) * oxf * oyf + tex(ix + 1, iy) * xf * oyf +
+			                    tex(ix, iy + 1) * oxf * yf +
+			                    tex(ix + 1, iy + 1) * xf * yf;
+		}
+	}
+	return {result};
+}
+
+ReferenceData CubicAdvectionReference(int n, const ReferenceData& inputs) {
+	const vector<float>& vx = inputs[0];
+	const vector<float>& vy = inputs[1];
+	Grid tex = {n, inputs[2].data()};
+	vector<float> result(n * n);
+	for (int i = 0; i < n; i++) {
+		for (int j = 0; j < n; j++) {
+			float x = (float)i - vx[i * n + j];
+			float y = (float)j - vy[i * n + j];
+			float xi = std::floor(x);
+			float yi = std::floor(y);
+			float wx[4], wy[4];
+			CubicHermit(x - xi, wx);
+			CubicHermit(y - yi, wy);
+			int ix = (int)xi;
+			int iy = (int)yi;
+			float value_y = 0.0f;
+			for (int dy = -1; dy < 3; dy++) {
+				float value_x = 0.0f;
+				for (int dx = -1; dx < 3; dx++) {
+					value_x = value_x + tex(ix + dx, iy + dy) * wx[dx + 1];
+				}
+				value_y = value_y + value_x * wy[dy + 1];
+			}
+			result[i * n + j] = value_y;
+		}
+	}
+	return {result};
+}
+
+ReferenceData RowStencilReference(int n, const ReferenceData& inputs) {
+	Grid A = {n, inputs[0].data()};
+	vector<float> result(n * n);
+	for (int i = 0; i < n; i++) {
+		for (int j = 0; j < n; j++) {
+			result[i * n + j] = A(i, j + 1) + A(i, 0);
+		}
+	}
+	return {result};
+}
+
+}  // namespace TensorFrost
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <vector>
+
+namespace TensorFrost {
+
+using namespace std;
+
+// Plain scalar versions of the programs in Programs.h, used to check the
+// benchmark outputs. Tensors are row major float arrays, loads clamp their
+// indices to the edges like the programs do. Every function takes the
+// inputs in program order and returns the outputs in program order.
+using ReferenceData = vector<vector<float>>;
+
+ReferenceData MatMulReference(int n, const ReferenceData& inputs);
+ReferenceData WaveEqReference(int n, const ReferenceData& inputs);
+ReferenceData JacobiReference(int n, const ReferenceData& inputs);
+ReferenceData MandelbrotReference(int S, const ReferenceData& inputs);
+ReferenceData BilinearAdvectionReference(int n, const ReferenceData& inputs);
+ReferenceData CubicAdvectionReference(int n, const ReferenceData& inputs);
+ReferenceData RowStencilReference(int n, const ReferenceData& inputs);
+
+}  // namespace TensorFrost
@@ -0,0 +1,21 @@
+import TensorFrost as tf
+import numpy as np
+
+tf.initialize(tf.cpu)
+
+# float32 tensors are copied as they are
+a = np.arange(12, dtype=np.float32).reshape(3, 4)
+A = tf.from_dlpack(a)
+assert A.numpy.shape == (3, 4)
+assert np.array_equal(A.numpy, a)
+
+# other types would be read as float bits, so they are rejected
+for dtype in [np.int32, np.uint32, np.float64]:
+    try:
+        tf.from_dlpack(np.arange(12, dtype=dtype).reshape(3, 4))
+    except Exception as e:
+        assert "float32" in str(e), e
+    else:
+        raise AssertionError(f"{np.dtype(dtype).name} tensor was accepted")
+
+print("dlpack test passed")
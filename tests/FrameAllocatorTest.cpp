@@ -0,0 +1,64 @@
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+
+#include "Backend/FrameAllocator.h"
+
+using namespace TensorFrost;
+
+// Checks of the frame allocator's address range limits, exits with 1 on the
+// first failure.
+
+int failures = 0;
+
+void Check(bool condition, const char* what) {
+	if (!condition) {
+		printf("FAILED: %s\n", what);
+		failures++;
+	}
+}
+
+template <typename Function>
+bool Throws(Function function) {
+	try {
+		function();
+	} catch (const std::runtime_error&) {
+		return true;
+	}
+	return false;
+}
+
+int main() {
+	{
+		// rounding up to the alignment would wrap around to a small frame
+		FrameAllocator allocator;
+		Check(Throws([&] { allocator.AllocateFrame(UINT32_MAX); }),
+		      "a frame whose aligned size overflows is rejected");
+		Check(allocator.GetRequiredAllocatedStorage() == 0,
+		      "a rejected frame leaves the heap empty");
+	}
+	{
+		// the second frame would end past 2^32 and overlap the first one
+		FrameAllocator allocator;
+		Frame* first = allocator.AllocateFrame(0x80000000u);
+		Check(Throws([&] { allocator.AllocateFrame(0x80000000u); }),
+		      "a frame past the end of the address range is rejected");
+		Check(allocator.GetRequiredAllocatedStorage() == 0x80000000u,
+		      "a rejected frame doesn't grow the heap");
+
+		// the space that is left can still be used
+		Frame* second = allocator.AllocateFrame(0x7FFFFFF0u);
+		Check(second->start == first->end && second->end == 0xFFFFFFF0u,
+		      "the rest of the address range can be allocated");
+		allocator.FreeFrame(second);
+		allocator.FreeFrame(first);
+		Check(allocator.GetRequiredAllocatedStorage() == 0,
+		      "freeing every frame empties the heap");
+	}
+
+	if (failures > 0) {
+		return 1;
+	}
+	printf("FrameAllocator tests passed\n");
+	return 0;
+}